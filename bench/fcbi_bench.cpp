@@ -0,0 +1,236 @@
+// Kernel throughput benchmark.
+// Runs every phase and the whole strip pipeline on synthetic planes for each supported opt level and both ed settings.
+// MP/s and MB/s are counted on the output plane (2x width, 2x height).
+// x2x2 runs the pipeline twice through a stored 2x plane, like chained filters, and x4 cascades both steps with factor 4. Both are counted on the 4x plane.
+// x4 sizes the windows and buffers of both steps to stay in L2 together instead of storing the 2x plane, but computes a few rows at the seams of its chunks twice,
+// so it is about as fast as x2x2 when the 2x plane fits in the last level cache.
+// flat varies by 1 LSB, so that it still runs the kernels, and fill times a constant plane, which process_frame fills without them.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fcbi.h"
+#include "fcbi_thread_pool.h"
+
+static const char* const pattern_names[]{ "flat", "gradient", "noise", "edges" };
+
+template <typename T>
+static void fill_plane(std::vector<uint8_t>& plane, const int width, const int height, const int pitch, const int bits, const int pattern)
+{
+    const int peak{ (bits == 32) ? 1 : (1 << bits) - 1 };
+    std::mt19937 rng{ 1 };
+
+    for (int y{ 0 }; y < height; ++y)
+    {
+        T* row{ reinterpret_cast<T*>(plane.data() + static_cast<size_t>(y) * pitch) };
+
+        for (int x{ 0 }; x < width; ++x)
+        {
+            switch (pattern)
+            {
+                case 0: row[x] = (std::is_floating_point_v<T>) ? static_cast<T>(0.5 + static_cast<int>(rng() % 3 - 1) / 1024.0) :
+                    static_cast<T>(peak / 2 + static_cast<int>(rng() % 3) - 1); break;
+                case 1: row[x] = (std::is_floating_point_v<T>) ? static_cast<T>(static_cast<double>(x + y) / (width + height)) :
+                    static_cast<T>(static_cast<int64_t>(x + y) * peak / (width + height)); break;
+                case 2: row[x] = (std::is_floating_point_v<T>) ? static_cast<T>(rng() / 4294967296.0) : static_cast<T>(rng() & peak); break;
+                default: row[x] = static_cast<T>((((x / 8) ^ (y / 8)) & 1) ? peak : 0);
+            }
+        }
+    }
+}
+
+// Calls f until at least min_time has passed and returns the average milliseconds per call.
+template <typename F>
+static double measure(F&& f, const double min_time)
+{
+    f();
+
+    int iterations{ 0 };
+    const auto start{ std::chrono::steady_clock::now() };
+    double elapsed{ 0.0 };
+
+    do
+    {
+        f();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < min_time);
+
+    return elapsed * 1000.0 / iterations;
+}
+
+template <typename T>
+static void run(const int opt, const int width, const int height, const int bits, const double min_time)
+{
+    const int dwidth{ 2 * width };
+    const int dheight{ 2 * height };
+    const int spitch{ (width * static_cast<int>(sizeof(T)) + 63) & ~63 };
+    const int dpitch{ (dwidth * static_cast<int>(sizeof(T)) + 63) & ~63 };
+    const int qpitch{ (2 * dwidth * static_cast<int>(sizeof(T)) + 63) & ~63 };
+    const int wpitch{ ((dwidth + 4) * static_cast<int>(sizeof(T)) + 63) & ~63 };
+    const int tm{ (bits == 32) ? 30 : 30 * ((1 << bits) - 1) / 255 };
+    const double mpixels{ static_cast<double>(dwidth) * dheight / 1e6 };
+
+    std::vector<uint8_t> src(static_cast<size_t>(spitch) * height);
+    std::vector<uint8_t> constant(static_cast<size_t>(spitch) * height);
+    std::vector<uint8_t> dst(static_cast<size_t>(dpitch) * dheight);
+    std::vector<uint8_t> dst4(static_cast<size_t>(qpitch) * 2 * dheight);
+    // One spare row for the left padding, the plane and the two rows phase1 writes below it.
+    std::vector<uint8_t> plane(static_cast<size_t>(wpitch) * (dheight + 2) + 64);
+    uint8_t* planep{ plane.data() + wpitch };
+
+    const fcbi_layout layout{ plan_layout(width, height, sizeof(T), 2) };
+    const fcbi_layout layout2{ plan_layout(dwidth, dheight, sizeof(T), 2) };
+    const fcbi_layout layout4{ plan_layout(width, height, sizeof(T), 4) };
+    scratch_pool scratch{ std::max(layout2.size, layout4.size) };
+    thread_pool pool{ 1 };
+
+    // A constant plane is filled from a single upscaled row whatever the kernels.
+    {
+        for (int y{ 0 }; y < height; ++y)
+            std::fill_n(reinterpret_cast<T*>(constant.data() + static_cast<size_t>(y) * spitch), width,
+                static_cast<T>((bits == 32) ? 0.5 : (1 << bits) / 2));
+
+        const fcbi_kernels& k{ select_kernels(opt, sizeof(T), false) };
+        const fcbi_plane args{ constant.data(), spitch, width, height, dst.data(), dpitch };
+        const double ms{ measure([&] { process_frame(&args, 1, scratch, layout, tm, 1, pool, k); }, min_time) };
+
+        printf("%3d %4d %5dx%-5d %-8s %2d %-8s %10.3f %10.1f %10.1f\n", opt, bits, width, height, "constant", 0, "fill", ms, mpixels / ms * 1000.0,
+            mpixels * sizeof(T) / ms * 1000.0);
+    }
+
+    for (int pattern{ 0 }; pattern < 4; ++pattern)
+    {
+        fill_plane<T>(src, width, height, spitch, bits, pattern);
+
+        for (int ed{ 0 }; ed < 2; ++ed)
+        {
+            const fcbi_kernels& k{ select_kernels(opt, sizeof(T), ed) };
+            const fcbi_plane args{ src.data(), spitch, width, height, dst.data(), dpitch };
+            const fcbi_plane args2{ dst.data(), dpitch, dwidth, dheight, dst4.data(), qpitch };
+            const fcbi_plane args4{ src.data(), spitch, width, height, dst4.data(), qpitch };
+
+            const double ms[7]
+            {
+                measure([&] { k.phase1(src.data(), planep, width, height, spitch, wpitch, 0, height); }, min_time),
+                measure([&] { k.phase2(planep, dwidth, dheight, wpitch, tm, 0, dheight); }, min_time),
+                measure([&] { k.phase3(planep, dst.data(), dwidth, dheight, wpitch, dpitch, tm, 0, dheight); }, min_time),
+                measure([&] { process_frame(&args, 1, scratch, layout, tm, 1, pool, k); }, min_time),
+                measure([&]
+                {
+                    process_frame(&args, 1, scratch, layout, tm, 1, pool, k);
+                    process_frame(&args2, 1, scratch, layout2, tm, 1, pool, k);
+                }, min_time),
+                measure([&] { process_frame(&args4, 1, scratch, layout4, tm, 1, pool, k); }, min_time),
+                measure([&] { k.bilinear(src.data(), dst.data(), width, height, spitch, dpitch, 0, dheight); }, min_time)
+            };
+
+            static const char* const stages[]{ "phase1", "phase2", "phase3", "total", "x2x2", "x4", "bilinear" };
+
+            for (int i{ 0 }; i < 7; ++i)
+            {
+                const double mp{ (i < 4 || i == 6) ? mpixels : 4.0 * mpixels };
+                printf("%3d %4d %5dx%-5d %-8s %2d %-8s %10.3f %10.1f %10.1f\n", opt, bits, width, height, pattern_names[pattern], ed, stages[i],
+                    ms[i], mp / ms[i] * 1000.0, mp * sizeof(T) / ms[i] * 1000.0);
+            }
+        }
+    }
+}
+
+static void usage()
+{
+    printf("usage: fcbi_bench [-o opt] [-b bits] [-s WIDTHxHEIGHT] [-t seconds]\n"
+        "  -o  opt level to run (0..3), default: all supported\n"
+        "  -b  bit depth of the source (8..16, 32 for float), default: 8 and 16\n"
+        "  -s  source size, default: 720x480, 1920x1080 and 3840x2160\n"
+        "  -t  minimum time per measurement, default: 0.2\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> opts;
+    std::vector<int> depths;
+    std::vector<std::pair<int, int>> sizes;
+    double min_time{ 0.2 };
+
+    for (int i{ 1 }; i < argc; ++i)
+    {
+        const std::string arg{ argv[i] };
+
+        if (i + 1 >= argc || arg.size() != 2 || arg[0] != '-')
+        {
+            usage();
+            return 1;
+        }
+
+        const char* value{ argv[++i] };
+
+        switch (arg[1])
+        {
+            case 'o': opts.emplace_back(atoi(value)); break;
+            case 'b': depths.emplace_back(atoi(value)); break;
+            case 's':
+            {
+                int w{ 0 };
+                int h{ 0 };
+                if (sscanf(value, "%dx%d", &w, &h) != 2 || w < 16 || h < 16)
+                {
+                    usage();
+                    return 1;
+                }
+                sizes.emplace_back(w, h);
+                break;
+            }
+            case 't': min_time = atof(value); break;
+            default: usage(); return 1;
+        }
+    }
+
+    if (opts.empty())
+        for (int opt{ 0 }; opt <= max_opt(); ++opt)
+            opts.emplace_back(opt);
+    if (depths.empty())
+        depths = { 8, 16 };
+    if (sizes.empty())
+        sizes = { { 720, 480 }, { 1920, 1080 }, { 3840, 2160 } };
+
+    for (const int opt : opts)
+    {
+        if (opt < 0 || opt > max_opt())
+        {
+            fprintf(stderr, "fcbi_bench: opt=%d is not supported by this CPU.\n", opt);
+            return 1;
+        }
+    }
+
+    for (const int bits : depths)
+    {
+        if ((bits < 8 || bits > 16) && bits != 32)
+        {
+            fprintf(stderr, "fcbi_bench: bit depth must be between 8..16 or 32.\n");
+            return 1;
+        }
+    }
+
+    printf("%3s %4s %11s %-8s %2s %-8s %10s %10s %10s\n", "opt", "bits", "size", "pattern", "ed", "stage", "ms", "MP/s", "MB/s");
+
+    for (const auto& [width, height] : sizes)
+        for (const int bits : depths)
+            for (const int opt : opts)
+            {
+                if (bits == 8)
+                    run<uint8_t>(opt, width, height, bits, min_time);
+                else if (bits == 32)
+                    run<float>(opt, width, height, bits, min_time);
+                else
+                    run<uint16_t>(opt, width, height, bits, min_time);
+            }
+
+    return 0;
+}
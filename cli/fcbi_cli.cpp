@@ -0,0 +1,620 @@
+// Y4M upscaler: reads YUV4MPEG2 from stdin and writes the 2x stream to stdout.
+// The main thread parses the input, a pool of workers upscales whole frames and a writer thread outputs them in order.
+// Frames travel in a fixed set of slots, so at most workers + 2 frames are in memory and a slow consumer stalls the reader.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "fcbi_core.h"
+
+struct y4m_format
+{
+    int width;
+    int height;
+    int bits;
+    int num_planes;
+    int subsampling_w;
+    int subsampling_h;
+    // As _ChromaLocation.
+    int chroma_location;
+};
+
+struct frame_slot
+{
+    int64_t n;
+    // The FRAME line including its parameters, written unchanged.
+    std::string header;
+    std::vector<uint8_t> src;
+    std::vector<uint8_t> dst;
+};
+
+// Blocking FIFO; pop() returns false once the channel is closed and empty.
+template <typename T>
+class channel
+{
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool closed{ false };
+
+public:
+    void push(T item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.emplace_back(std::move(item));
+        }
+
+        cv.notify_one();
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return closed || !items.empty(); });
+
+        if (items.empty())
+            return false;
+
+        item = std::move(items.front());
+        items.pop_front();
+
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+
+        cv.notify_all();
+    }
+};
+
+// Hands finished frames to the writer in input order.
+// Frame n + slots can not be in flight before frame n is written, so slot n % slots is never taken twice.
+class reorder_buffer
+{
+    std::vector<frame_slot*> ready;
+    std::mutex mutex;
+    std::condition_variable cv;
+    int64_t frames{ -1 };
+    bool aborted{ false };
+
+public:
+    explicit reorder_buffer(const size_t slots)
+        : ready(slots, nullptr)
+    {
+    }
+
+    void put(frame_slot* slot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready[slot->n % ready.size()] = slot;
+        }
+
+        cv.notify_all();
+    }
+
+    // Called by the reader with the number of frames it queued.
+    void finish(const int64_t count)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            frames = count;
+        }
+
+        cv.notify_all();
+    }
+
+    void abort()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            aborted = true;
+        }
+
+        cv.notify_all();
+    }
+
+    // Returns nullptr after the last frame or on abort.
+    frame_slot* take(const int64_t n)
+    {
+        frame_slot*& slot{ ready[n % ready.size()] };
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return aborted || n == frames || (slot && slot->n == n); });
+
+        if (aborted || !slot || slot->n != n)
+            return nullptr;
+
+        frame_slot* s{ slot };
+        slot = nullptr;
+
+        return s;
+    }
+};
+
+static std::mutex error_mutex;
+static std::string error_message;
+
+static void set_error(const std::string& message)
+{
+    std::lock_guard<std::mutex> lock(error_mutex);
+
+    if (error_message.empty())
+        error_message = message;
+}
+
+// Reads up to and excluding '\n'. Returns false on EOF before the first character.
+static bool read_line(std::string& line)
+{
+    line.clear();
+
+    int c{ getc(stdin) };
+    if (c == EOF)
+        return false;
+
+    for (; c != EOF && c != '\n'; c = getc(stdin))
+    {
+        if (line.size() >= 4096)
+            return false;
+
+        line += static_cast<char>(c);
+    }
+
+    return c == '\n';
+}
+
+static bool parse_colorspace(const std::string& c, y4m_format& f)
+{
+    f.bits = 8;
+
+    if (!c.compare(0, 4, "mono"))
+    {
+        f.num_planes = 1;
+        f.subsampling_w = f.subsampling_h = 0;
+
+        if (c.size() > 4)
+            f.bits = atoi(c.c_str() + 4);
+
+        return f.bits >= 8 && f.bits <= 16;
+    }
+
+    const std::string chroma{ c.substr(0, 3) };
+    const std::string rest{ c.substr(std::min<size_t>(c.size(), 3)) };
+
+    f.num_planes = 3;
+
+    if (chroma == "420")
+        f.subsampling_w = f.subsampling_h = 1;
+    else if (chroma == "422")
+        f.subsampling_w = 1, f.subsampling_h = 0;
+    else if (chroma == "444")
+        f.subsampling_w = f.subsampling_h = 0;
+    else if (chroma == "411")
+        f.subsampling_w = 2, f.subsampling_h = 0;
+    else
+        return false;
+
+    // 420 and 420jpeg are center sited, everything else is taken as left sited like MPEG-2.
+    f.chroma_location = (chroma == "420" && (rest.empty() || rest == "jpeg")) ? 1 : (rest == "paldv") ? 2 : 0;
+
+    if (rest.empty() || rest == "jpeg" || rest == "mpeg2" || rest == "paldv")
+        return true;
+    if (rest[0] != 'p')
+        return false;
+
+    f.bits = atoi(rest.c_str() + 1);
+
+    // Samples are stored as 8- or 16-bit integers.
+    return f.bits >= 8 && f.bits <= 16;
+}
+
+// Colorspace of f at another bit depth, 8-bit 4:2:0 keeps the chroma siting.
+static std::string output_colorspace(const y4m_format& f, const int bits)
+{
+    const std::string depth{ std::to_string(bits) };
+
+    if (f.num_planes == 1)
+        return (bits == 8) ? "mono" : "mono" + depth;
+
+    const std::string chroma{ (f.subsampling_w == 0) ? "444" : (f.subsampling_h == 0) ? "422" : "420" };
+
+    if (bits > 8)
+        return chroma + "p" + depth;
+    if (chroma != "420")
+        return chroma;
+
+    return (f.chroma_location == 1) ? "420jpeg" : (f.chroma_location == 2) ? "420paldv" : "420mpeg2";
+}
+
+// Parses the stream header and returns its colorspace and its tags other than W, H and C, which change with the output.
+static bool parse_header(const std::string& line, y4m_format& f, std::string& colorspace, std::string& tags)
+{
+    if (line.compare(0, 10, "YUV4MPEG2 "))
+        return false;
+
+    f = {};
+    colorspace = "420jpeg";
+    tags.clear();
+
+    size_t pos{ 10 };
+
+    while (pos < line.size())
+    {
+        size_t end{ line.find(' ', pos) };
+        if (end == std::string::npos)
+            end = line.size();
+
+        const std::string token{ line.substr(pos, end - pos) };
+        pos = end + 1;
+
+        if (token.empty())
+            continue;
+
+        switch (token[0])
+        {
+            case 'W': f.width = atoi(token.c_str() + 1); continue;
+            case 'H': f.height = atoi(token.c_str() + 1); continue;
+            case 'C': colorspace = token.substr(1); continue;
+        }
+
+        tags += " " + token;
+    }
+
+    return f.width > 0 && f.height > 0 && parse_colorspace(colorspace, f);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: fcbi-cli [--ed] [--tm N] [--opt N] [--threads N] [--factor N] [--width N] [--height N] [--center] [--output-bits N] [--dither] [--chroma N]\n"
+        "                [--crop-left N] [--crop-top N] [--crop-right N] [--crop-bottom N] [--reuse] [--stats] [--workers N] < input.y4m > output.y4m\n"
+        "  --ed       use edge detection\n"
+        "  --tm       threshold for edge detection, default: 30 * (2 ^ bit_depth - 1) / 255\n"
+        "  --opt      -1: auto-detect, 0: C++, 1: SSE2, 2: AVX2, 3: AVX512, default: -1\n"
+        "  --threads  threads per frame, 0: all logical cores, default: 1\n"
+        "  --factor   2, 4 or 8, default: 2\n"
+        "  --width    width the upscaled frames are resized to, default: factor * width\n"
+        "  --height   height the upscaled frames are resized to, default: factor * height\n"
+        "  --center   re-center the output on the source, chroma siting is taken from the header\n"
+        "  --output-bits  bit depth of the output, 8..16, default: bit depth of the input\n"
+        "  --dither   dither instead of rounding when --output-bits is lower than the input bit depth\n"
+        "  --chroma   0: FCBI, 1: bilinear, 2: keep the source size (4:4:4 with --factor 2 only, written as 4:2:0), default: 0\n"
+        "  --crop-left, --crop-top, --crop-right, --crop-bottom  samples removed from each side of the output, only the rest is computed, default: 0\n"
+        "  --reuse    upscale only the rows whose source changed since the last frame, best with --workers 1 and --threads 0\n"
+        "  --stats    print the average time of each step per frame when done\n"
+        "  --workers  frames processed at once, default: number of logical cores\n");
+}
+
+int main(int argc, char** argv)
+{
+    fcbi_params params;
+    fcbi_default_params(&params);
+    int workers{ static_cast<int>(std::thread::hardware_concurrency()) };
+
+    for (int i{ 1 }; i < argc; ++i)
+    {
+        const std::string arg{ argv[i] };
+
+        if (arg == "--ed")
+        {
+            params.edge = 1;
+            continue;
+        }
+
+        if (arg == "--center")
+        {
+            params.center = 1;
+            continue;
+        }
+
+        if (arg == "--dither")
+        {
+            params.dither = 1;
+            continue;
+        }
+
+        if (arg == "--reuse")
+        {
+            params.reuse = 1;
+            continue;
+        }
+
+        if (arg == "--stats")
+        {
+            params.stats = 1;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 1;
+        }
+
+        const int value{ atoi(argv[++i]) };
+
+        if (arg == "--tm")
+            params.tm = value;
+        else if (arg == "--opt")
+            params.opt = value;
+        else if (arg == "--threads")
+            params.threads = value;
+        else if (arg == "--factor")
+            params.factor = value;
+        else if (arg == "--width")
+            params.target_width = value;
+        else if (arg == "--height")
+            params.target_height = value;
+        else if (arg == "--output-bits")
+            params.output_bits = value;
+        else if (arg == "--chroma")
+            params.chroma = value;
+        else if (arg == "--crop-left")
+            params.crop_left = value;
+        else if (arg == "--crop-top")
+            params.crop_top = value;
+        else if (arg == "--crop-right")
+            params.crop_right = value;
+        else if (arg == "--crop-bottom")
+            params.crop_bottom = value;
+        else if (arg == "--workers")
+            workers = value;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    workers = std::max(workers, 1);
+
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    std::string line;
+    std::string colorspace;
+    std::string tags;
+    y4m_format f;
+
+    if (!read_line(line) || !parse_header(line, f, colorspace, tags))
+    {
+        fprintf(stderr, "fcbi-cli: input is not a supported YUV4MPEG2 stream.\n");
+        return 1;
+    }
+
+    if ((f.width & ((1 << f.subsampling_w) - 1)) || (f.height & ((1 << f.subsampling_h) - 1)))
+    {
+        fprintf(stderr, "fcbi-cli: frame size must be a multiple of the chroma subsampling.\n");
+        return 1;
+    }
+
+    params.width = f.width;
+    params.height = f.height;
+    params.bits = f.bits;
+    params.num_planes = f.num_planes;
+    params.subsampling_w = f.subsampling_w;
+    params.subsampling_h = f.subsampling_h;
+    params.chroma_location = f.chroma_location;
+
+    // Y4M has no subsampling coarser than 4:2:0.
+    if (params.chroma == 2 && f.num_planes == 3 && (f.subsampling_w || f.subsampling_h || params.factor != 2))
+    {
+        fprintf(stderr, "fcbi-cli: --chroma 2 requires 4:4:4 input and --factor 2.\n");
+        return 1;
+    }
+
+    std::unique_ptr<fcbi_context, decltype(&fcbi_free)> core{ fcbi_create(&params), fcbi_free };
+    if (!core)
+    {
+        fprintf(stderr, "fcbi-cli: %s\n", fcbi_last_error());
+        return 1;
+    }
+
+    // Planes are stored back to back without padding, the source frame is followed by slack for kernels loading whole vectors at the end of a row.
+    constexpr size_t tail_slack{ 64 };
+    const int output_bits{ (params.output_bits) ? params.output_bits : f.bits };
+    const int size{ (f.bits == 8) ? 1 : 2 };
+    const int output_size{ (output_bits == 8) ? 1 : 2 };
+    size_t src_offset[3]{};
+    size_t dst_offset[3]{};
+    ptrdiff_t spitch[3]{};
+    ptrdiff_t dpitch[3]{};
+    size_t src_size{ 0 };
+    size_t dst_size{ 0 };
+
+    for (int p{ 0 }; p < f.num_planes; ++p)
+    {
+        const int w{ (p) ? f.width >> f.subsampling_w : f.width };
+        const int h{ (p) ? f.height >> f.subsampling_h : f.height };
+
+        src_offset[p] = src_size;
+        dst_offset[p] = dst_size;
+        spitch[p] = static_cast<ptrdiff_t>(w) * size;
+        dpitch[p] = static_cast<ptrdiff_t>(fcbi_output_width(core.get(), p)) * output_size;
+        src_size += spitch[p] * h;
+        dst_size += dpitch[p] * fcbi_output_height(core.get(), p);
+    }
+
+    setvbuf(stdin, nullptr, _IOFBF, 1 << 20);
+    setvbuf(stdout, nullptr, _IOFBF, 1 << 20);
+
+    // Chroma kept at the source size is 4:2:0, sited on the source samples: top left, or center once the luma is re-centered.
+    y4m_format out{ f };
+
+    if (params.chroma == 2 && f.num_planes == 3)
+    {
+        out.subsampling_w = out.subsampling_h = 1;
+        out.chroma_location = (params.center) ? 1 : 2;
+    }
+
+    const bool same_format{ output_bits == f.bits && out.subsampling_w == f.subsampling_w && out.subsampling_h == f.subsampling_h };
+    const std::string out_header{ "YUV4MPEG2 W" + std::to_string(fcbi_output_width(core.get(), 0)) + " H" +
+        std::to_string(fcbi_output_height(core.get(), 0)) + " C" + ((same_format) ? colorspace : output_colorspace(out, output_bits)) + tags + "\n" };
+
+    if (fwrite(out_header.data(), 1, out_header.size(), stdout) != out_header.size())
+    {
+        fprintf(stderr, "fcbi-cli: can not write the output.\n");
+        return 1;
+    }
+
+    // One slot being read, one being written and one per worker.
+    std::vector<frame_slot> slots(workers + 2);
+    channel<frame_slot*> free_slots;
+    channel<frame_slot*> work;
+    reorder_buffer done{ slots.size() };
+    std::atomic<bool> failed{ false };
+    // Sums of the stats of every frame: phase1, phase2, phase3, output and total.
+    std::atomic<int64_t> stats[5]{};
+
+    for (auto& slot : slots)
+    {
+        slot.src.resize(src_size + tail_slack);
+        slot.dst.resize(dst_size);
+        free_slots.push(&slot);
+    }
+
+    const auto fail{ [&](const std::string& message)
+    {
+        set_error(message);
+        failed = true;
+        free_slots.close();
+        done.abort();
+    } };
+
+    std::vector<std::thread> threads;
+
+    for (int i{ 0 }; i < workers; ++i)
+    {
+        threads.emplace_back([&]
+        {
+            frame_slot* slot;
+
+            while (work.pop(slot))
+            {
+                if (failed)
+                    continue;
+
+                const uint8_t* srcp[3];
+                uint8_t* dstp[3];
+
+                for (int p{ 0 }; p < f.num_planes; ++p)
+                {
+                    srcp[p] = slot->src.data() + src_offset[p];
+                    dstp[p] = slot->dst.data() + dst_offset[p];
+                }
+
+                if (fcbi_process_frame(core.get(), srcp, spitch, dstp, dpitch))
+                {
+                    fail(fcbi_last_error());
+                    continue;
+                }
+
+                if (params.stats)
+                {
+                    fcbi_stats s;
+                    fcbi_last_stats(&s);
+                    stats[0] += s.phase1_us;
+                    stats[1] += s.phase2_us;
+                    stats[2] += s.phase3_us;
+                    stats[3] += s.output_us;
+                    stats[4] += s.total_us;
+                }
+
+                done.put(slot);
+            }
+        });
+    }
+
+    threads.emplace_back([&]
+    {
+        for (int64_t n{ 0 };; ++n)
+        {
+            frame_slot* slot{ done.take(n) };
+            if (!slot)
+                break;
+
+            if (fwrite(slot->header.data(), 1, slot->header.size(), stdout) != slot->header.size() ||
+                fwrite(slot->dst.data(), 1, slot->dst.size(), stdout) != slot->dst.size())
+            {
+                fail("can not write the output.");
+                break;
+            }
+
+            free_slots.push(slot);
+        }
+
+        if (fflush(stdout))
+            fail("can not write the output.");
+    });
+
+    // The main thread reads.
+    int64_t n{ 0 };
+    frame_slot* slot;
+
+    while (free_slots.pop(slot))
+    {
+        if (!read_line(line))
+        {
+            if (!feof(stdin) || !line.empty())
+                fail("invalid frame header.");
+            break;
+        }
+
+        if (line.compare(0, 5, "FRAME"))
+        {
+            fail("invalid frame header.");
+            break;
+        }
+
+        if (fread(slot->src.data(), 1, src_size, stdin) != src_size)
+        {
+            fail("truncated frame.");
+            break;
+        }
+
+        slot->n = n++;
+        slot->header = line + '\n';
+        work.push(slot);
+    }
+
+    work.close();
+    done.finish(n);
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (failed)
+    {
+        fprintf(stderr, "fcbi-cli: %s\n", error_message.c_str());
+        return 1;
+    }
+
+    if (params.stats && n)
+        fprintf(stderr, "fcbi-cli: %lld frames, microseconds per frame: phase1 %lld, phase2 %lld, phase3 %lld, output %lld, total %lld\n",
+            static_cast<long long>(n), static_cast<long long>(stats[0] / n), static_cast<long long>(stats[1] / n), static_cast<long long>(stats[2] / n),
+            static_cast<long long>(stats[3] / n), static_cast<long long>(stats[4] / n));
+
+    return 0;
+}
@@ -1,14 +1,278 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <type_traits>
+#include <vector>
 
+// Kernels are instantiated for uint8_t (8-bit), uint16_t (10..16-bit) and float samples.
+// Integer samples are interpolated in int with rounding, float samples in float.
 template <typename T>
-void phase1_c(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch) noexcept;
+using accum_t = std::conditional_t<std::is_floating_point_v<T>, float, int>;
+
+// tm is given on the 8-bit scale for float samples.
+template <typename T>
+constexpr accum_t<T> threshold(const int tm) noexcept
+{
+    if constexpr (std::is_floating_point_v<T>)
+        return tm / 255.0f;
+    else
+        return tm;
+}
+
+template <typename T>
+void phase1_c(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template <typename T>
+void phase1_sse2(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template <typename T>
+void phase1_avx2(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
 template <typename T>
-void phase1_sse2(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch) noexcept;
+void phase1_avx512(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+
+template <typename T, bool EDGE>
+void phase2_c(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template <typename T, bool EDGE>
+void phase2_sse2(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template <typename T, bool EDGE>
+void phase2_sse41(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template <typename T, bool EDGE>
+void phase2_avx2(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template <typename T, bool EDGE>
+void phase2_avx512(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
 
 template <typename T, bool EDGE>
-void phase2_c(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
+void phase3_c(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
 template <typename T, bool EDGE>
-void phase3_c(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
+void phase3_sse2(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template <typename T, bool EDGE>
+void phase3_sse41(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template <typename T, bool EDGE>
+void phase3_avx2(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template <typename T, bool EDGE>
+void phase3_avx512(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+
+// Bilinear 2x of the output rows [top, bottom) (even) of a plane of width x height samples, on the same grid as FCBI:
+// the source samples on the even positions and the averages of the neighbours on the odd ones, the last row and column repeated.
+// srcp is source row top / 2 and dstp output row top. Used for the planes that are not worth the three phases.
+template <typename T>
+void bilinear_c(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template <typename T>
+void bilinear_sse2(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template <typename T>
+void bilinear_avx2(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template <typename T>
+void bilinear_avx512(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+
+struct fcbi_kernels
+{
+    void (*phase1)(const uint8_t* srcp, uint8_t* __restrict dstp, const int width, const int height, const int spitch, const int dpitch, const int top, const int bottom) noexcept;
+    void (*phase2)(uint8_t* __restrict ptr, const int width, const int height, const int pitch, const int tm, const int top, const int bottom) noexcept;
+    void (*phase3)(const uint8_t* srcp, uint8_t* __restrict dstp, const int width, const int height, const int spitch, const int dpitch, const int tm, const int top, const int bottom) noexcept;
+    void (*bilinear)(const uint8_t* srcp, uint8_t* __restrict dstp, const int width, const int height, const int spitch, const int dpitch, const int top, const int bottom) noexcept;
+};
+
+// Highest opt level supported by the CPU, detected once per process.
+int max_opt() noexcept;
+
+// Instruction sets required by opt, for error messages.
+const char* opt_requirement(const int opt) noexcept;
+
+// Best kernels of opt for the sample size (1, 2 or 4 bytes for float) and edge detection, opt -1 selects max_opt().
+// opt must not be higher than max_opt().
+const fcbi_kernels& select_kernels(const int opt, const int component_size, const bool edge) noexcept;
+
+// Rows of the window scratch that are not part of a strip:
+// the halo read by phase2 and phase3, the rows phase1 runs ahead and one row above holding the left padding.
+constexpr int strip_halo{ 14 };
+
+// Output rows per strip, so that a strip and its halo stay in L2 along with the other parts - 1 buffers of the same size used with it.
+int strip_height(const int row_size, const int height, const int parts = 1) noexcept;
+
+// Runs phase1..phase3 on the output rows [top, bottom) of one plane strip by strip, phase3 writes the finished rows to dstp.
+// wndp is a scratch of strip + strip_halo rows of wpitch bytes. top and bottom must be even.
+// Bands of the same plane can run concurrently with their own scratch.
+void process_plane(const uint8_t* srcp, const int spitch, const int width, const int height, uint8_t* __restrict dstp, const int dpitch,
+    uint8_t* __restrict wndp, const int wpitch, const int strip, const int tm, const int top, const int bottom,
+    const fcbi_kernels& kernels) noexcept;
+
+// Separable resize of the upscaled planes to the target size, applied strip by strip.
+// Output sample i of an axis is the sum of weights[i * taps + t] * input[first[i] + t], the inputs are always inside the plane.
+struct fcbi_resize_axis
+{
+    int taps;
+    // Index of output sample 0 in the axis before crop_axis(), the dither is anchored there.
+    int offset;
+    std::vector<int> first;
+    std::vector<float> weights;
+};
+
+struct fcbi_resize
+{
+    fcbi_resize_axis x;
+    fcbi_resize_axis y;
+    // Filters rows of the upscaled plane horizontally into rows of float.
+    void (*horizontal)(const uint8_t* srcp, const int spitch, float* __restrict dstp, const int dpitch, const int rows, const fcbi_resize_axis& axis) noexcept;
+    // Filters the rows of float (spitch floats apart) read by output row y vertically into that row.
+    // Integer samples are multiplied by scale, rounded or dithered and clamped to 0..peak.
+    void (*vertical)(const float* srcp, const int spitch, uint8_t* __restrict dstp, const int y, const fcbi_resize& resize) noexcept;
+    float scale;
+    int peak;
+    bool dither;
+};
+
+// Most taps of a resize from src_size to dst_size samples.
+int resize_taps(const int src_size, const int dst_size) noexcept;
+
+// Catmull-Rom bicubic, stretched by the ratio when downscaling.
+// shift moves the output samples by that many input samples, an axis of equal sizes without shift copies the samples.
+fcbi_resize_axis resize_axis(const int src_size, const int dst_size, const double shift);
+
+// Shift of a resize axis that moves the source samples of an upscale by factor from the even output samples to the sample centers.
+// size is the upscaled plane size, target_size its resized size, ss the log2 subsampling of the plane on the axis and
+// siting the position of the chroma samples between the luma samples: 0 left/top, 0.5 center, 1 bottom.
+double center_shift(const int size, const int target_size, const int factor, const int ss, const double siting) noexcept;
+
+// Keeps the output samples [first, first + size) of axis.
+void crop_axis(fcbi_resize_axis& axis, const int first, const int size);
+
+// bits is the bit depth of the upscaled plane and output_bits that of the output (at most bits), 32 for float samples.
+fcbi_resize make_resize(const int src_width, const int src_height, const int dst_width, const int dst_height, const double shift_x,
+    const double shift_y, const int bits, const int output_bits, const bool dither);
+
+// 8x8 ordered dither, values 0..63.
+extern const uint8_t dither_matrix[8][8];
+
+// Bit depth conversion of integer planes. Planes are upscaled at the higher of the source and output depths:
+// a higher output depth converts the source rows before phase1, so that the averages keep their fractions,
+// a lower one converts the upscaled rows with rounding or the ordered dither.
+struct fcbi_convert
+{
+    // Shifts rows of width source samples left by shift into 16-bit samples.
+    void (*source)(const uint8_t* srcp, const int spitch, uint8_t* __restrict dstp, const int dpitch, const int width, const int rows,
+        const int shift) noexcept;
+    // Shifts rows of width 16-bit samples right by shift into output samples clamped to peak, x and y are the position of the first one in the
+    // uncropped plane.
+    void (*output)(const uint8_t* srcp, const int spitch, uint8_t* __restrict dstp, const int dpitch, const int width, const int x, const int y,
+        const int rows, const fcbi_convert& convert) noexcept;
+    int shift;
+    // Highest output sample, only used by output.
+    int peak;
+    bool dither;
+    // Bytes per sample read by source.
+    int source_size;
+};
+
+// bits and output_bits are 8..16 and differ, only one of source and output is set.
+fcbi_convert make_convert(const int bits, const int output_bits, const bool dither) noexcept;
+
+// Scratch of one thread for a 2x, 4x or 8x upscale, computed once per format.
+// Every 2x stage has its own window. Between two stages a buffer holds the rows of the first one that the next chunk of the second one reads,
+// so the intermediate planes are never stored whole. Converted source rows and rows converted to the output depth or cropped go through such buffers too.
+struct fcbi_layout
+{
+    // log2 of the factor.
+    int stages;
+    // Window of each stage: pitch, strip and byte offset in the scratch.
+    int wpitch[3];
+    int strip[3];
+    size_t window[3];
+    // Output rows of stage k computed per pass, and the pitch and offset of the rows they read: the converted source for stage 0,
+    // the output of stage k - 1 otherwise. Index stages holds the upscaled rows converted to the output depth or cropped, see output_band().
+    int chunk[4];
+    int ipitch[4];
+    size_t buffer[4];
+    // Resized planes: rows of the upscaled plane read by a chunk of output rows, and the same rows filtered horizontally.
+    int rrows;
+    int rpitch;
+    size_t rbuffer;
+    int hpitch;
+    size_t hbuffer;
+    // Bytes per upscaled sample.
+    int component_size;
+    // Bytes per thread, a multiple of the cache line.
+    size_t size;
+};
+
+// width and height are the size of the largest source plane, target_width and target_height the size it is resized to (0: not resized).
+// component_size is that of the upscaled samples. convert_source tells that the source is converted before the upscale,
+// buffer_output that the upscaled rows are converted to the output depth or cropped to a rectangle that dstp can not take directly.
+// A resize converts and crops by itself.
+fcbi_layout plan_layout(const int width, const int height, const int component_size, const int factor, const int target_width = 0,
+    const int target_height = 0, const bool convert_source = false, const bool buffer_output = false) noexcept;
+
+// Source samples computed on each side of a cropped rectangle, so that its samples are the same as those of the whole plane.
+// phase3 reads two samples around its own, phase2 three around those, and the borders of a stage are handled differently.
+constexpr int crop_halo{ 8 };
+
+// Source and output of the last frame of a plane, kept to skip the rows of the next frame whose source did not change. Rows are stored unpadded.
+struct fcbi_history
+{
+    std::vector<uint8_t> source;
+    std::vector<uint8_t> output;
+    // Bytes per row of source and output.
+    int source_row;
+    int output_row;
+    // Number of source rows above each row (and the last one) that differ from source, counted by process_frame.
+    std::vector<int> changed;
+    // False until the first frame is stored.
+    bool valid;
+};
+
+// Output rows of a plane with a history that are copied or computed together.
+constexpr int reuse_tile{ 32 };
+
+class scratch_pool;
+class thread_pool;
+class trace_recorder;
+
+// How a plane is brought to the output size.
+enum class plane_mode
+{
+    // The three phases of FCBI.
+    fcbi,
+    // kernels.bilinear in place of the three phases, resized and converted like an FCBI plane.
+    bilinear,
+    // Not upscaled: the source is copied, converted to the output depth if needed. Never resized.
+    copy
+};
+
+struct fcbi_plane
+{
+    const uint8_t* srcp;
+    int spitch;
+    int width;
+    int height;
+    uint8_t* dstp;
+    int dpitch;
+    // Resize of the upscaled plane, dstp then holds the resized plane.
+    const fcbi_resize* resize{ nullptr };
+    // Bit depth conversion, dstp then holds samples of the output depth.
+    const fcbi_convert* convert{ nullptr };
+    plane_mode mode{ plane_mode::fcbi };
+    // Rectangle of the upscaled plane that is written to dstp, crop_width 0 writes the whole plane. Resized planes are cropped by their resize,
+    // copied planes by srcp, width and height, their crop_x and crop_y only anchor the dither.
+    int crop_x{ 0 };
+    int crop_y{ 0 };
+    int crop_width{ 0 };
+    int crop_height{ 0 };
+    // Last frame of the plane, only the output rows whose source rows changed are computed, the others are copied from it.
+    // Never set for copied planes, and only used by one process_frame at a time.
+    fcbi_history* history{ nullptr };
+};
+
+// Nanoseconds a process_frame call spent in phase1 (or the bilinear kernel), phase2 and phase3, summed over its threads,
+// and in everything else: the resize, conversions, copies and the checks for constant planes and changed rows.
+struct fcbi_timing
+{
+    int64_t phase1;
+    int64_t phase2;
+    int64_t phase3;
+    int64_t output;
+};
+
+// Upscales every plane by 2^layout.stages (or copies it, see plane_mode), resizes and converts the planes that have a resize or a conversion. Planes are split into at most threads bands and all of them run on pool.
+// The buffers of scratch hold layout.size bytes per thread. timing is filled when it is not null. When trace is not null, every band and kernel call
+// is recorded as a span of frame.
+void process_frame(const fcbi_plane* planes, const int num_planes, scratch_pool& scratch, const fcbi_layout& layout, const int tm,
+    const int threads, thread_pool& pool, const fcbi_kernels& kernels, fcbi_timing* timing = nullptr, trace_recorder* trace = nullptr,
+    const int64_t frame = 0);
@@ -1,19 +1,17 @@
 #include "avisynth.h"
-#include "fcbi.h"
-#include "VCL2/instrset.h"
+#include "fcbi_core.h"
 
 class FCBI : public GenericVideoFilter
 {
-    int tm;
-    VideoInfo vit;
+    fcbi_context* core;
     bool v8;
-
-    void (*process_phase1)(const uint8_t* srcp, uint8_t* __restrict dstp, const int width, const int height, const int spitch, const int dpitch) noexcept;
-    void (*process_phase2)(uint8_t* __restrict ptr, const int width, const int height, const int pitch, const int tm) noexcept;
-    void (*process_phase3)(uint8_t* __restrict ptr, const int width, const int height, const int pitch, const int tm) noexcept;
+    bool stats;
 
 public:
-    FCBI(PClip child, bool edge, int tm, int opt, IScriptEnvironment* env);
+    FCBI(PClip child, bool edge, int tm, int opt, int threads, int factor, int width, int height, bool center, int chroma_loc,
+        int output_bits, bool dither, int chroma, int crop_left, int crop_top, int crop_right, int crop_bottom, bool reuse,
+        bool stats, IScriptEnvironment* env);
+    ~FCBI();
     PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env) override;
 
     int __stdcall SetCacheHints(int hints, int) override
@@ -22,13 +20,13 @@ public:
     }
 };
 
-FCBI::FCBI(PClip _c, bool _e, int _t, int opt, IScriptEnvironment* env)
-    : GenericVideoFilter(_c), tm(_t), v8(true)
+FCBI::FCBI(PClip child, bool edge, int tm, int opt, int threads, int factor, int width, int height, bool center, int chroma_loc,
+    int output_bits, bool dither, int chroma, int crop_left, int crop_top, int crop_right, int crop_bottom, bool reuse, bool stats,
+    IScriptEnvironment* env)
+    : GenericVideoFilter(child), v8(true), stats(stats)
 {
     if (!vi.IsPlanar() || vi.IsRGB())
         env->ThrowError("FCBI: input clip is not planar YUV format.");
-    if (vi.ComponentSize() == 4)
-        env->ThrowError("FCBI: bit depth of input clip is must be 8..16-bit.");
     if (vi.NumComponents() == 4)
         env->ThrowError("FCBI: alpha is unsupported.");
     if (vi.IsYV411())
@@ -36,69 +34,71 @@ FCBI::FCBI(PClip _c, bool _e, int _t, int opt, IScriptEnvironment* env)
     if (vi.width < 16 || vi.height < 16)
         env->ThrowError("FCBI: input clip is too small.");
 
-    const int peak{ (1 << vi.BitsPerComponent()) - 1 };
-
-    if (tm == -1)
-        tm = (vi.ComponentSize() == 1) ? 30 : (30 * peak / 255);
-    if (tm < 0 || tm > peak)
-        env->ThrowError("FCBI: tm is out of range.");
-    if (opt < -1 || opt > 1)
-        env->ThrowError("FCBI: opt must be between -1..1.");
+    fcbi_params params;
+    fcbi_default_params(&params);
+    params.width = vi.width;
+    params.height = vi.height;
+    params.bits = vi.BitsPerComponent();
+    params.num_planes = vi.NumComponents();
+    params.subsampling_w = (vi.NumComponents() > 1) ? vi.GetPlaneWidthSubsampling(PLANAR_U) : 0;
+    params.subsampling_h = (vi.NumComponents() > 1) ? vi.GetPlaneHeightSubsampling(PLANAR_U) : 0;
+    params.edge = edge;
+    params.tm = tm;
+    params.opt = opt;
+    params.threads = threads;
+    params.factor = factor;
+    params.target_width = width;
+    params.target_height = height;
+    params.center = center;
+    params.chroma_location = chroma_loc;
+    // AviSynth has no 9, 11, 13 and 15-bit formats.
+    if (output_bits && output_bits != 8 && output_bits != 10 && output_bits != 12 && output_bits != 14 && output_bits != 16)
+        env->ThrowError("FCBI: output_bits must be 8, 10, 12, 14 or 16.");
+    params.output_bits = output_bits;
+    params.dither = dither;
+    // Chroma kept at the source size is only an AviSynth format for 4:4:4 at 2x, which becomes 4:2:0.
+    if (chroma == 2 && (vi.NumComponents() == 1 || !vi.Is444() || factor != 2))
+        env->ThrowError("FCBI: chroma=2 requires a 4:4:4 clip and factor=2.");
+    params.chroma = chroma;
+    params.crop_left = crop_left;
+    params.crop_top = crop_top;
+    params.crop_right = crop_right;
+    params.crop_bottom = crop_bottom;
+    params.reuse = reuse;
+    params.stats = stats;
+
+    core = fcbi_create(&params);
+    if (!core)
+        env->ThrowError("FCBI: %s", fcbi_last_error());
+
+    vi.width = fcbi_output_width(core, 0);
+    vi.height = fcbi_output_height(core, 0);
+
+    if (output_bits && output_bits != params.bits)
+    {
+        const int sample_bits{ (output_bits == 8) ? VideoInfo::CS_Sample_Bits_8 : (output_bits == 10) ? VideoInfo::CS_Sample_Bits_10 : (output_bits == 12) ?
+            VideoInfo::CS_Sample_Bits_12 : (output_bits == 14) ? VideoInfo::CS_Sample_Bits_14 : VideoInfo::CS_Sample_Bits_16 };
 
-    const int iset{ instrset_detect() };
-    if (opt == 1 && iset < 2)
-        env->ThrowError("FCBI: opt=1 requires SSE2.");
+        vi.pixel_type = (vi.pixel_type & ~VideoInfo::CS_Sample_Bits_Mask) | sample_bits;
+    }
 
-    vi.width *= 2;
-    vi.height *= 2;
+    if (chroma == 2)
+        vi.pixel_type = (vi.pixel_type & ~(VideoInfo::CS_Sub_Width_Mask | VideoInfo::CS_Sub_Height_Mask)) | VideoInfo::CS_Sub_Width_2 |
+            VideoInfo::CS_Sub_Height_2;
 
-    vit = vi;
+    try { env->CheckVersion(8); }
+    catch (const AvisynthError&) { v8 = false; }
 
-    if (vi.ComponentSize() == 1)
-    {
-        vit.pixel_type = VideoInfo::CS_Y8;
-        process_phase1 = ((opt == -1 && iset >= 2) || opt == 1) ? phase1_sse2<uint8_t> : phase1_c<uint8_t>;
-
-        if (_e)
-        {
-            process_phase2 = phase2_c<uint8_t, true>;
-            process_phase3 = phase3_c<uint8_t, true>;
-        }
-        else
-        {
-            process_phase2 = phase2_c<uint8_t, false>;
-            process_phase3 = phase3_c<uint8_t, false>;
-        }
-    }
-    else
+    if (stats && !v8)
     {
-        switch (vi.BitsPerComponent())
-        {
-            case 10: vit.pixel_type = VideoInfo::CS_Y10; break;
-            case 12: vit.pixel_type = VideoInfo::CS_Y12; break;
-            case 14: vit.pixel_type = VideoInfo::CS_Y14; break;
-            default: vit.pixel_type = VideoInfo::CS_Y16;
-        }
-
-        process_phase1 = ((opt == -1 && iset >= 2) || opt == 1) ? phase1_sse2<uint16_t> : phase1_c<uint16_t>;
-
-        if (_e)
-        {
-            process_phase2 = phase2_c<uint16_t, true>;
-            process_phase3 = phase3_c<uint16_t, true>;
-        }
-        else
-        {
-            process_phase2 = phase2_c<uint16_t, false>;
-            process_phase3 = phase3_c<uint16_t, false>;
-        }
+        fcbi_free(core);
+        env->ThrowError("FCBI: stats requires frame properties (AviSynth+ interface version 8).");
     }
+}
 
-    vit.width = (vit.width + 4 + 31) & ~31;
-    vit.height += 2;
-
-    try { env->CheckVersion(8); }
-    catch (const AvisynthError&) { v8 = false; }
+FCBI::~FCBI()
+{
+    fcbi_free(core);
 }
 
 PVideoFrame __stdcall FCBI::GetFrame(int n, IScriptEnvironment* env)
@@ -106,22 +106,35 @@ PVideoFrame __stdcall FCBI::GetFrame(int n, IScriptEnvironment* env)
     const int planes[3]{ PLANAR_Y, PLANAR_U, PLANAR_V };
 
     PVideoFrame src{ child->GetFrame(n, env) };
-    PVideoFrame tmp{ env->NewVideoFrame(vit) };
     PVideoFrame dst{ (v8) ? env->NewVideoFrameP(vi, &src) : env->NewVideoFrame(vi) };
 
-    const int tpitch{ tmp->GetPitch() };
-    uint8_t* __restrict tmpp{ tmp->GetWritePtr() + tpitch };
+    const uint8_t* srcp[3];
+    ptrdiff_t spitch[3];
+    uint8_t* dstp[3];
+    ptrdiff_t dpitch[3];
 
     for (int p{ 0 }; p < vi.NumComponents(); ++p)
     {
-        const int width{ dst->GetRowSize(planes[p]) / vi.ComponentSize() };
-        const int height{ dst->GetHeight(planes[p]) };
+        srcp[p] = src->GetReadPtr(planes[p]);
+        spitch[p] = src->GetPitch(planes[p]);
+        dstp[p] = dst->GetWritePtr(planes[p]);
+        dpitch[p] = dst->GetPitch(planes[p]);
+    }
 
-        process_phase1(src->GetReadPtr(planes[p]), tmpp, src->GetRowSize(planes[p]) / vi.ComponentSize(), src->GetHeight(planes[p]), src->GetPitch(planes[p]), tpitch);
-        process_phase2(tmpp, width, height, tpitch, tm);
-        process_phase3(tmpp, width, height, tpitch, tm);
+    if (fcbi_process_frame(core, srcp, spitch, dstp, dpitch))
+        env->ThrowError("FCBI: %s", fcbi_last_error());
 
-        env->BitBlt(reinterpret_cast<uint8_t*>(dst->GetWritePtr(planes[p])), dst->GetPitch(planes[p]), reinterpret_cast<uint8_t*>(tmpp), tpitch, dst->GetRowSize(planes[p]), height);
+    if (stats)
+    {
+        fcbi_stats s;
+        fcbi_last_stats(&s);
+
+        AVSMap* props{ env->getFramePropsRW(dst) };
+        env->propSetInt(props, "_FCBIPhase1Us", s.phase1_us, PROPAPPENDMODE_REPLACE);
+        env->propSetInt(props, "_FCBIPhase2Us", s.phase2_us, PROPAPPENDMODE_REPLACE);
+        env->propSetInt(props, "_FCBIPhase3Us", s.phase3_us, PROPAPPENDMODE_REPLACE);
+        env->propSetInt(props, "_FCBIOutputUs", s.output_us, PROPAPPENDMODE_REPLACE);
+        env->propSetInt(props, "_FCBITotalUs", s.total_us, PROPAPPENDMODE_REPLACE);
     }
 
     return dst;
@@ -129,9 +142,13 @@ PVideoFrame __stdcall FCBI::GetFrame(int n, IScriptEnvironment* env)
 
 AVSValue __cdecl FCBI_create(AVSValue args, void*, IScriptEnvironment* env)
 {
-    enum opt { CLIP, ED, TM, OPT };
+    enum opt { CLIP, ED, TM, OPT, THREADS, FACTOR, WIDTH, HEIGHT, CENTER, CHROMA_LOC, OUTPUT_BITS, DITHER, CHROMA, CROP_LEFT, CROP_TOP, CROP_RIGHT,
+        CROP_BOTTOM, REUSE, STATS };
 
-    return new FCBI(args[CLIP].AsClip(), args[ED].AsBool(false), args[TM].AsInt(-1), args[OPT].AsInt(-1), env);
+    return new FCBI(args[CLIP].AsClip(), args[ED].AsBool(false), args[TM].AsInt(-1), args[OPT].AsInt(-1), args[THREADS].AsInt(1), args[FACTOR].AsInt(2),
+        args[WIDTH].AsInt(0), args[HEIGHT].AsInt(0), args[CENTER].AsBool(false),
+        args[CHROMA_LOC].AsInt(0), args[OUTPUT_BITS].AsInt(0), args[DITHER].AsBool(false), args[CHROMA].AsInt(0),
+        args[CROP_LEFT].AsInt(0), args[CROP_TOP].AsInt(0), args[CROP_RIGHT].AsInt(0), args[CROP_BOTTOM].AsInt(0), args[REUSE].AsBool(false), args[STATS].AsBool(false), env);
 }
 
 const AVS_Linkage* AVS_linkage = nullptr;
@@ -141,6 +158,7 @@ AvisynthPluginInit3(IScriptEnvironment * env, const AVS_Linkage* const vectors)
 {
     AVS_linkage = vectors;
 
-    env->AddFunction("FCBI", "c[ed]b[tm]i[opt]i", FCBI_create, 0);
+    env->AddFunction("FCBI", "c[ed]b[tm]i[opt]i[threads]i[factor]i[width]i[height]i[center]b[chroma_loc]i[output_bits]i[dither]b[chroma]i[crop_left]i[crop_top]i[crop_right]i[crop_bottom]i[reuse]b[stats]b",
+        FCBI_create, 0);
     return "FCBI for avisynth ver x.x.x";
 }
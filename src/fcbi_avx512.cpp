@@ -0,0 +1,58 @@
+#include "fcbi.h"
+#include "VCL2/vectorclass.h"
+#include "fcbi_simd.h"
+
+template <typename T>
+using sample_t = std::conditional_t<std::is_same_v<T, uint8_t>, Vec64uc, std::conditional_t<std::is_same_v<T, uint16_t>, Vec32us, Vec16f>>;
+template <typename T>
+using vec_t = std::conditional_t<std::is_same_v<T, uint8_t>, Vec32s, std::conditional_t<std::is_same_v<T, uint16_t>, Vec16i, Vec16f>>;
+
+template <typename T>
+void phase1_avx512(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept
+{
+    phase1_simd<T, sample_t<T>>(srcp_, dstp_, width, height, spitch, dpitch, top, bottom);
+}
+
+template void phase1_avx512<uint8_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template void phase1_avx512<uint16_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template void phase1_avx512<float>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+
+template <typename T>
+void bilinear_avx512(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept
+{
+    bilinear_simd<T, sample_t<T>>(srcp_, dstp_, width, height, spitch, dpitch, top, bottom);
+}
+
+template void bilinear_avx512<uint8_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template void bilinear_avx512<uint16_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template void bilinear_avx512<float>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+
+template <typename T, bool EDGE>
+void phase2_avx512(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept
+{
+    phase2_simd<T, vec_t<T>, EDGE>(ptr, width, height, pitch, tm, top, bottom);
+}
+
+template void phase2_avx512<uint8_t, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template void phase2_avx512<uint8_t, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+
+template void phase2_avx512<uint16_t, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template void phase2_avx512<uint16_t, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+
+template void phase2_avx512<float, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template void phase2_avx512<float, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+
+template <typename T, bool EDGE>
+void phase3_avx512(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept
+{
+    phase3_simd<T, vec_t<T>, EDGE>(srcp_, dstp_, width, height, spitch, dpitch, tm, top, bottom);
+}
+
+template void phase3_avx512<uint8_t, true>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template void phase3_avx512<uint8_t, false>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+
+template void phase3_avx512<uint16_t, true>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template void phase3_avx512<uint16_t, false>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+
+template void phase3_avx512<float, true>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template void phase3_avx512<float, false>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
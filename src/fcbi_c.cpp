@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 
 #include "fcbi.h"
@@ -28,128 +29,168 @@
 #endif
 
 template <typename T>
-static AVS_FORCEINLINE int mean(T x, T y) noexcept
+static AVS_FORCEINLINE T mean(T x, T y) noexcept
 {
-    return (x + y + 1) >> 1;
+    if constexpr (std::is_floating_point_v<T>)
+        return (x + y) * 0.5f;
+    else
+        return static_cast<T>((x + y + 1) >> 1);
 }
 
 template <typename T>
-void phase1_c(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch) noexcept
+void phase1_c(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept
 {
     spitch /= sizeof(T);
     dpitch /= sizeof(T);
     const T* srcp{ reinterpret_cast<const T*>(srcp_) };
     T* __restrict dstp{ reinterpret_cast<T*>(dstp_) };
 
-    dstp[-2] = dstp[-1] = srcp[0];
-
-    for (int x{ 0 }; x < width - 1; ++x)
-    {
-        dstp[2 * x] = srcp[x];
-        dstp[2 * x + 1] = mean<T>(srcp[x], srcp[x + 1]);
-    }
-
-    dstp[2 * width - 2] = dstp[2 * width - 1] = dstp[2 * width] = srcp[width - 1];
-    srcp += spitch;
-    dstp += 2 * dpitch;
-
-    for (int y{ 1 }; y < height - 1; ++y)
+    for (int y{ top }; y < bottom; ++y)
     {
         dstp[-2] = dstp[-1] = srcp[0];
 
-        if constexpr (std::is_same_v<T, uint8_t>)
+        if (y == 0 || y == height - 1)
+        {
+            for (int x{ 0 }; x < width - 1; ++x)
+            {
+                dstp[2 * x] = srcp[x];
+                dstp[2 * x + 1] = mean<T>(srcp[x], srcp[x + 1]);
+            }
+        }
+        else if constexpr (std::is_same_v<T, uint8_t>)
         {
             uint16_t* d16{ reinterpret_cast<uint16_t*>(dstp) };
             for (int x = 0; x < width - 1; ++x)
                 d16[x] = static_cast<uint16_t>(srcp[x]);
         }
-        else
+        else if constexpr (std::is_same_v<T, uint16_t>)
         {
             uint32_t* d32{ reinterpret_cast<uint32_t*>(dstp) };
             for (int x = 0; x < width - 1; ++x)
                 d32[x] = static_cast<uint32_t>(srcp[x]);
         }
+        else
+        {
+            for (int x = 0; x < width - 1; ++x)
+            {
+                dstp[2 * x] = srcp[x];
+                dstp[2 * x + 1] = 0.0f;
+            }
+        }
 
         dstp[2 * width - 2] = dstp[2 * width - 1] = dstp[2 * width] = srcp[width - 1];
         srcp += spitch;
         dstp += 2 * dpitch;
     }
 
-    dstp[-2] = dstp[-1] = srcp[0];
-
-    for (int x = 0; x < width - 1; ++x)
+    if (bottom == height)
     {
-        dstp[2 * x] = srcp[x];
-        dstp[2 * x + 1] = mean<T>(srcp[x], srcp[x + 1]);
+        dstp -= 2 * dpitch + 2;
+        memcpy(dstp + dpitch, dstp, (2 * width + 4) * sizeof(T));
+        dstp += dpitch;
+        memcpy(dstp + dpitch, dstp, (2 * width + 4) * sizeof(T));
     }
+}
+
+template void phase1_c<uint8_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template void phase1_c<uint16_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template void phase1_c<float>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+
+template <typename T>
+void bilinear_c(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept
+{
+    spitch /= sizeof(T);
+    dpitch /= sizeof(T);
+    const T* srcp{ reinterpret_cast<const T*>(srcp_) };
+    T* __restrict dstp{ reinterpret_cast<T*>(dstp_) };
+
+    for (int y{ top }; y < bottom; y += 2)
+    {
+        T* d0{ dstp };
+        T* d1{ dstp + dpitch };
+        // The odd rows average the upscaled rows above and below, the last one repeats the row above.
+        const T* s1{ (y / 2 < height - 1) ? srcp + spitch : srcp };
+
+        for (int x{ 0 }; x < width - 1; ++x)
+        {
+            d0[2 * x] = srcp[x];
+            d0[2 * x + 1] = mean<T>(srcp[x], srcp[x + 1]);
+            d1[2 * x] = mean<T>(srcp[x], s1[x]);
+            d1[2 * x + 1] = mean<T>(d0[2 * x + 1], mean<T>(s1[x], s1[x + 1]));
+        }
 
-    dstp[2 * width - 2] = dstp[2 * width - 1] = dstp[2 * width] = srcp[width - 1];
-    dstp -= 2;
-    memcpy(dstp + dpitch, dstp, (2 * width + 4) * sizeof(T));
-    dstp += dpitch;
-    memcpy(dstp + dpitch, dstp, (2 * width + 4) * sizeof(T));
+        d0[2 * width - 2] = d0[2 * width - 1] = srcp[width - 1];
+        d1[2 * width - 2] = d1[2 * width - 1] = mean<T>(srcp[width - 1], s1[width - 1]);
+        srcp += spitch;
+        dstp += 2 * dpitch;
+    }
 }
 
-template void phase1_c<uint8_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch) noexcept;
-template void phase1_c<uint16_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch) noexcept;
+template void bilinear_c<uint8_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template void bilinear_c<uint16_t>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
+template void bilinear_c<float>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept;
 
-static AVS_FORCEINLINE int abs_diff(int x, int y)
+template <typename S>
+static AVS_FORCEINLINE S abs_diff(S x, S y)
 {
     return x > y ? x - y : y - x;
 }
 
-static AVS_FORCEINLINE bool is_edge(int v1, int v2, int p1, int p2, int tm)
+// Both candidates are computed and one is selected without branches, so the speed does not depend on the content.
+// A sample is on an edge when abs_diff(v1, v2) >= tm, unless v1 < tm, v2 < tm and abs_diff(p1, p2) < tm * 2.
+// S is the accumulator type, the terms are summed in the order of the vector code so that float results match it.
+template <bool EDGE, typename S>
+static AVS_FORCEINLINE S interpolate(const S a1, const S a2, const S b1, const S b2, const S c1, const S c2, const S tm) noexcept
 {
-    if (abs_diff(v1, v2) < tm) {
-        return false;
+    const S p1{ a1 + a2 };
+    const S p2{ b1 + b2 };
+    const S h1{ c1 + p1 - 2 * p2 - p2 };
+    const S h2{ c2 + p2 - 2 * p1 - p1 };
+
+    bool use_p1{ std::abs(h1) < std::abs(h2) };
+
+    if constexpr (EDGE)
+    {
+        const S v1{ abs_diff(a1, a2) };
+        const S v2{ abs_diff(b1, b2) };
+        const bool edge{ static_cast<bool>((abs_diff(v1, v2) >= tm) & !((v1 < tm) & (v2 < tm) & (abs_diff(p1, p2) < tm * 2))) };
+
+        use_p1 = (edge & (v1 < v2)) | (!edge & use_p1);
     }
-    return !(v1 < tm&& v2 < tm&& abs_diff(p1, p2) < tm * 2);
+
+    if constexpr (std::is_floating_point_v<S>)
+        return (use_p1 ? p1 : p2) * 0.5f;
+    else
+        return ((use_p1 ? p1 : p2) + 1) >> 1;
 }
 
 template <typename T, bool EDGE>
-void phase2_c(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept
+void phase2_c(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept
 {
+    using S = accum_t<T>;
+
     pitch /= sizeof(T);
+    const S thr{ threshold<T>(tm) };
 
+    const int first{ std::max(top, 1) | 1 };
     const int p2{ 2 * pitch };
-    const T* s0{ reinterpret_cast<const T*>(ptr) };
-    const T* s1{ s0 };
+    T* __restrict dstp{ reinterpret_cast<T*>(ptr) + static_cast<ptrdiff_t>(first - top) * pitch };
+    const T* s0{ dstp - static_cast<ptrdiff_t>(std::min(first, 3)) * pitch };
+    const T* s1{ dstp - pitch };
     const T* s2{ s1 + p2 };
     const T* s3{ s2 + p2 };
 
-    T* __restrict dstp{ reinterpret_cast<T*>(ptr) + pitch };
-
-    for (int y{ 1 }; y < height - 1; y += 2)
+    for (int y{ first }; y < std::min(bottom, height - 1); y += 2)
     {
-        dstp[0] = mean<T>(s1[0], s2[0]);
+        // The left padding of the odd rows is read by phase3 (s1[x - 2] at x = 1).
+        dstp[-2] = dstp[-1] = dstp[0] = mean<T>(s1[0], s2[0]);
 
         for (int x{ 1 }; x < width - 2; x += 2)
         {
-            const int p1{ s1[x - 1] + s2[x + 1] };
-            const int p2{ s1[x + 1] + s2[x - 1] };
-
-            if constexpr (EDGE)
-            {
-                const int v1{ abs_diff(s1[x - 1], s2[x + 1]) };
-                const int v2{ abs_diff(s1[x + 1], s2[x - 1]) };
-
-                if (is_edge(v1, v2, p1, p2, tm))
-                {
-                    if (v1 < v2)
-                        dstp[x] = (p1 + 1) >> 1;
-                    else
-                        dstp[x] = (p2 + 1) >> 1;
-                    continue;
-                }
-            }
-
-            const int h1{ s0[x + 1] + s1[x + 3] + s2[x - 3] + s3[x - 1] + p1 - 3 * p2 };
-            const int h2{ s0[x - 1] + s1[x - 3] + s2[x + 3] + s3[x + 1] + p2 - 3 * p1 };
+            const S c1{ s0[x + 1] + s1[x + 3] + s2[x - 3] + s3[x - 1] };
+            const S c2{ s0[x - 1] + s1[x - 3] + s2[x + 3] + s3[x + 1] };
 
-            if (std::abs(h1) < std::abs(h2))
-                dstp[x] = (p1 + 1) / 2;
-            else
-                dstp[x] = (p2 + 1) / 2;
+            dstp[x] = static_cast<T>(interpolate<EDGE, S>(s1[x - 1], s2[x + 1], s1[x + 1], s2[x - 1], c1, c2, thr));
         }
 
         dstp[width - 2] = dstp[width - 1] = mean<T>(s1[width - 2], s2[width - 2]);
@@ -162,66 +203,58 @@ void phase2_c(uint8_t* __restrict ptr, int width, const int height, int pitch, c
     }
 }
 
-template void phase2_c<uint8_t, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
-template void phase2_c<uint8_t, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
+template void phase2_c<uint8_t, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template void phase2_c<uint8_t, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
 
-template void phase2_c<uint16_t, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
-template void phase2_c<uint16_t, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
+template void phase2_c<uint16_t, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template void phase2_c<uint16_t, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+
+template void phase2_c<float, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template void phase2_c<float, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
 
 template <typename T, bool EDGE>
-void phase3_c(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept
+void phase3_c(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept
 {
-    pitch /= sizeof(T);
+    using S = accum_t<T>;
 
-    const T* s0{ reinterpret_cast<const T*>(ptr) };
-    const T* s1{ reinterpret_cast<const T*>(ptr) };
-    const T* s2{ s1 + pitch };
-    const T* s3{ s2 + pitch };
-    const T* s4{ s3 + pitch };
-
-    T* __restrict dstp{ reinterpret_cast<T*>(ptr) + pitch };
+    const S thr{ threshold<T>(tm) };
+    spitch /= sizeof(T);
+    dpitch /= sizeof(T);
+    const T* srcp{ reinterpret_cast<const T*>(srcp_) };
+    T* __restrict dstp{ reinterpret_cast<T*>(dstp_) };
 
-    for (int y{ 1 }; y < height - 2; ++y)
+    for (int y{ top }; y < bottom; ++y)
     {
-        for (int x{ 1 + (y & 1) }; x < width - 2; x += 2)
+        // The samples of the previous phases are copied, the rest is interpolated from them.
+        memcpy(dstp, srcp, width * sizeof(T));
+
+        if (y > 0 && y < height - 2)
         {
-            const int p1{ s2[x - 1] + s2[x + 1] };
-            const int p2{ s1[x] + s3[x] };
+            const T* s0{ srcp - static_cast<ptrdiff_t>(std::min(y, 2)) * spitch };
+            const T* s1{ srcp - spitch };
+            const T* s2{ srcp };
+            const T* s3{ s2 + spitch };
+            const T* s4{ s3 + spitch };
 
-            if constexpr (EDGE)
+            for (int x{ 1 + (y & 1) }; x < width - 2; x += 2)
             {
-                const int v1{ abs_diff(s2[x - 1], s2[x + 1]) };
-                const int v2{ abs_diff(s1[x], s3[x]) };
-
-                if (is_edge(v1, v2, p1, p2, tm))
-                {
-                    if (v1 < v2)
-                        dstp[x] = (p1 + 1) / 2;
-                    else
-                        dstp[x] = (p2 + 1) / 2;
-                    continue;
-                }
-            }
+                const S c1{ s0[x - 1] + s0[x + 1] + s4[x - 1] + s4[x + 1] };
+                const S c2{ s1[x - 2] + s1[x + 2] + s3[x - 2] + s3[x + 2] };
 
-            const int h1{ s0[x - 1] + s0[x + 1] + s4[x - 1] + s4[x + 1] + p1 - 3 * p2 };
-            const int h2{ s1[x - 2] + s1[x + 2] + s3[x - 2] + s3[x + 2] + p2 - 3 * p1 };
-            if (std::abs(h1) < std::abs(h2))
-                dstp[x] = (p1 + 1) / 2;
-            else
-                dstp[x] = (p2 + 1) / 2;
+                dstp[x] = static_cast<T>(interpolate<EDGE, S>(s2[x - 1], s2[x + 1], s1[x], s3[x], c1, c2, thr));
+            }
         }
 
-        s0 = s1;
-        s1 = s2;
-        s2 = s3;
-        s3 = s4;
-        s4 += pitch;
-        dstp += pitch;
+        srcp += spitch;
+        dstp += dpitch;
     }
 }
 
-template void phase3_c<uint8_t, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
-template void phase3_c<uint8_t, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
+template void phase3_c<uint8_t, true>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template void phase3_c<uint8_t, false>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+
+template void phase3_c<uint16_t, true>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template void phase3_c<uint16_t, false>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
 
-template void phase3_c<uint16_t, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
-template void phase3_c<uint16_t, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm) noexcept;
+template void phase3_c<float, true>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template void phase3_c<float, false>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include "fcbi.h"
+
+const uint8_t dither_matrix[8][8]
+{
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+template <typename T>
+static void convert_source(const uint8_t* srcp_, const int spitch, uint8_t* __restrict dstp_, const int dpitch, const int width, const int rows,
+    const int shift) noexcept
+{
+    for (int y{ 0 }; y < rows; ++y)
+    {
+        const T* srcp{ reinterpret_cast<const T*>(srcp_ + static_cast<ptrdiff_t>(y) * spitch) };
+        uint16_t* __restrict dstp{ reinterpret_cast<uint16_t*>(dstp_ + static_cast<ptrdiff_t>(y) * dpitch) };
+
+        for (int x{ 0 }; x < width; ++x)
+            dstp[x] = static_cast<uint16_t>(srcp[x] << shift);
+    }
+}
+
+template <typename T>
+static void convert_output(const uint8_t* srcp_, const int spitch, uint8_t* __restrict dstp_, const int dpitch, const int width, const int x0,
+    const int y, const int rows, const fcbi_convert& convert) noexcept
+{
+    const int shift{ convert.shift };
+
+    for (int i{ 0 }; i < rows; ++i)
+    {
+        const uint16_t* srcp{ reinterpret_cast<const uint16_t*>(srcp_ + static_cast<ptrdiff_t>(i) * spitch) };
+        T* __restrict dstp{ reinterpret_cast<T*>(dstp_ + static_cast<ptrdiff_t>(i) * dpitch) };
+
+        // Rounding offsets added before the shift, x & 7 selects one. Samples near the peak round up past it.
+        int bias[8];
+        for (int x{ 0 }; x < 8; ++x)
+            bias[x] = (convert.dither) ? ((2 * dither_matrix[(y + i) & 7][(x0 + x) & 7] + 1) << shift) >> 7 : 1 << (shift - 1);
+
+        for (int x{ 0 }; x < width; ++x)
+            dstp[x] = static_cast<T>(std::min((srcp[x] + bias[x & 7]) >> shift, convert.peak));
+    }
+}
+
+fcbi_convert make_convert(const int bits, const int output_bits, const bool dither) noexcept
+{
+    fcbi_convert convert{};
+    convert.dither = dither;
+
+    if (output_bits > bits)
+    {
+        convert.source = (bits == 8) ? convert_source<uint8_t> : convert_source<uint16_t>;
+        convert.shift = output_bits - bits;
+        convert.source_size = (bits == 8) ? 1 : 2;
+    }
+    else
+    {
+        convert.output = (output_bits == 8) ? convert_output<uint8_t> : convert_output<uint16_t>;
+        convert.shift = bits - output_bits;
+        convert.peak = (1 << output_bits) - 1;
+    }
+
+    return convert;
+}
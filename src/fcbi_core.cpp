@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "fcbi.h"
+#include "fcbi_core.h"
+#include "fcbi_thread_pool.h"
+#include "fcbi_trace.h"
+
+struct fcbi_context
+{
+    int num_planes;
+    int width[3];
+    int height[3];
+    int output_width[3];
+    int output_height[3];
+    plane_mode mode[3];
+    // Top left corner of the output in the upscaled plane, or in the source plane of a copied plane. Resized planes are cropped by their resize.
+    int crop_x[3];
+    int crop_y[3];
+    int source_size;
+
+    int tm;
+    fcbi_layout layout;
+    // Only used when the output is resized or converted.
+    fcbi_resize resize[3];
+    fcbi_convert convert;
+    // Only used with reuse, planes that are not copied have a history.
+    fcbi_history history[3];
+    std::mutex history_lock[3];
+    int threads;
+    bool stats;
+    // Only set when FCBI_TRACE is, frames are numbered in the order the calls start.
+    std::unique_ptr<trace_recorder> trace;
+    std::atomic<int64_t> frames;
+    std::unique_ptr<thread_pool> pool;
+    std::unique_ptr<scratch_pool> scratch;
+
+    fcbi_kernels kernels;
+};
+
+static thread_local std::string last_error;
+static thread_local fcbi_stats last_stats;
+
+static void set_error(std::string error) noexcept
+{
+    last_error = std::move(error);
+}
+
+static fcbi_context* fail(std::string error) noexcept
+{
+    set_error(std::move(error));
+    return nullptr;
+}
+
+void fcbi_default_params(fcbi_params* params)
+{
+    *params = {};
+    params->factor = 2;
+    params->tm = -1;
+    params->opt = -1;
+    params->threads = 1;
+}
+
+fcbi_context* fcbi_create(const fcbi_params* params)
+{
+    const fcbi_params& p{ *params };
+
+    if (p.width < 16 || p.height < 16)
+        return fail("width and height must be at least 16.");
+    if ((p.bits < 8 || p.bits > 16) && p.bits != 32)
+        return fail("bits must be between 8..16 or 32.");
+    if (p.num_planes != 1 && p.num_planes != 3)
+        return fail("num_planes must be 1 or 3.");
+    if (p.num_planes == 3 && (p.subsampling_w < 0 || p.subsampling_w > 1 || p.subsampling_h < 0 || p.subsampling_h > 1))
+        return fail("subsampling is unsupported.");
+
+    // tm of float samples is on the 8-bit scale.
+    const int peak{ (p.bits == 32) ? 255 : (1 << p.bits) - 1 };
+    const int tm{ (p.tm == -1) ? 30 * peak / 255 : p.tm };
+
+    if (tm < 0 || tm > peak)
+        return fail("tm is out of range.");
+    if (p.factor != 2 && p.factor != 4 && p.factor != 8)
+        return fail("factor must be 2, 4 or 8.");
+
+    const int target_width{ (p.target_width) ? p.target_width : p.factor * p.width };
+    const int target_height{ (p.target_height) ? p.target_height : p.factor * p.height };
+
+    if (target_width < 1 || target_width > p.factor * p.width || target_height < 1 || target_height > p.factor * p.height)
+        return fail("target_width and target_height must be between 1 and the upscaled size.");
+    if (p.num_planes == 3 && ((target_width & ((1 << p.subsampling_w) - 1)) || (target_height & ((1 << p.subsampling_h) - 1))))
+        return fail("target_width and target_height must be a multiple of the chroma subsampling.");
+    // Integer clips are upscaled at the higher of bits and output_bits, float clips stay float.
+    const int output_bits{ (p.output_bits) ? p.output_bits : p.bits };
+
+    if ((p.bits == 32) ? output_bits != 32 : (output_bits < 8 || output_bits > 16))
+        return fail("output_bits must be between 8..16, or 32 for float clips.");
+    if (p.chroma_location < 0 || p.chroma_location > 5)
+        return fail("chroma_location must be between 0..5.");
+    if (p.chroma < 0 || p.chroma > 2)
+        return fail("chroma must be between 0..2.");
+    if (p.opt < -1 || p.opt > 3)
+        return fail("opt must be between -1..3.");
+    if (p.threads < 0)
+        return fail("threads must be greater than or equal to 0.");
+    if (p.opt > max_opt())
+        return fail("opt=" + std::to_string(p.opt) + " requires " + opt_requirement(p.opt) + ".");
+
+    try
+    {
+        std::unique_ptr<fcbi_context> d{ std::make_unique<fcbi_context>() };
+        const int bits{ std::max(p.bits, output_bits) };
+        const int component_size{ (bits == 8) ? 1 : (bits == 32) ? 4 : 2 };
+
+        const bool scaled{ target_width != p.factor * p.width || target_height != p.factor * p.height };
+
+        if (scaled && p.chroma == 2)
+            return fail("chroma=2 can not be combined with target_width and target_height.");
+        if (p.crop_left < 0 || p.crop_top < 0 || p.crop_right < 0 || p.crop_bottom < 0 || p.crop_left + p.crop_right >= target_width ||
+            p.crop_top + p.crop_bottom >= target_height)
+            return fail("crop must leave at least one column and row of the output.");
+
+        // Chroma kept at the source size is subsampled by factor more.
+        const int chroma_w{ (p.num_planes == 1) ? 1 : (p.chroma == 2) ? p.factor << p.subsampling_w : 1 << p.subsampling_w };
+        const int chroma_h{ (p.num_planes == 1) ? 1 : (p.chroma == 2) ? p.factor << p.subsampling_h : 1 << p.subsampling_h };
+
+        if (p.crop_left % chroma_w || p.crop_right % chroma_w || p.crop_top % chroma_h || p.crop_bottom % chroma_h)
+            return fail("crop must be a multiple of the chroma subsampling of the output.");
+
+        const bool cropped{ p.crop_left || p.crop_top || p.crop_right || p.crop_bottom };
+        const int output_size{ (output_bits == 8) ? 1 : (output_bits == 32) ? 4 : 2 };
+
+        const bool resized{ scaled || p.center };
+        // Horizontal and vertical position of the chroma samples between the luma samples.
+        const double siting_x{ (p.chroma_location & 1) ? 0.5 : 0.0 };
+        const double siting_y{ (p.chroma_location < 2) ? 0.5 : (p.chroma_location < 4) ? 0.0 : 1.0 };
+
+        d->num_planes = p.num_planes;
+        d->source_size = (p.bits == 8) ? 1 : (p.bits == 32) ? 4 : 2;
+        for (int i{ 0 }; i < p.num_planes; ++i)
+        {
+            const int ssw{ (i) ? p.subsampling_w : 0 };
+            const int ssh{ (i) ? p.subsampling_h : 0 };
+
+            d->mode[i] = (i == 0 || p.chroma == 0) ? plane_mode::fcbi : (p.chroma == 1) ? plane_mode::bilinear : plane_mode::copy;
+            d->width[i] = p.width >> ssw;
+            d->height[i] = p.height >> ssh;
+
+            // Size of the plane before the crop, and the crop in its samples.
+            const int div_w{ (d->mode[i] == plane_mode::copy) ? p.factor << ssw : 1 << ssw };
+            const int div_h{ (d->mode[i] == plane_mode::copy) ? p.factor << ssh : 1 << ssh };
+            const int full_width{ (d->mode[i] == plane_mode::copy) ? d->width[i] : (scaled) ? target_width >> ssw : p.factor * d->width[i] };
+            const int full_height{ (d->mode[i] == plane_mode::copy) ? d->height[i] : (scaled) ? target_height >> ssh : p.factor * d->height[i] };
+
+            d->crop_x[i] = p.crop_left / div_w;
+            d->crop_y[i] = p.crop_top / div_h;
+            d->output_width[i] = full_width - (p.crop_left + p.crop_right) / div_w;
+            d->output_height[i] = full_height - (p.crop_top + p.crop_bottom) / div_h;
+
+            if (resized && d->mode[i] != plane_mode::copy)
+            {
+                const int uwidth{ p.factor * d->width[i] };
+                const int uheight{ p.factor * d->height[i] };
+                const double shift_x{ (p.center) ? center_shift(uwidth, full_width, p.factor, ssw, siting_x) : 0.0 };
+                const double shift_y{ (p.center) ? center_shift(uheight, full_height, p.factor, ssh, siting_y) : 0.0 };
+
+                d->resize[i] = make_resize(uwidth, uheight, full_width, full_height, shift_x, shift_y, bits, output_bits, p.dither);
+                crop_axis(d->resize[i].x, d->crop_x[i], d->output_width[i]);
+                crop_axis(d->resize[i].y, d->crop_y[i], d->output_height[i]);
+            }
+
+            if (p.reuse && d->mode[i] != plane_mode::copy)
+            {
+                fcbi_history& history{ d->history[i] };
+                history.source_row = d->width[i] * d->source_size;
+                history.output_row = d->output_width[i] * output_size;
+                history.source.resize(static_cast<size_t>(d->height[i]) * history.source_row);
+                history.output.resize(static_cast<size_t>(d->output_height[i]) * history.output_row);
+                history.changed.resize(static_cast<size_t>(d->height[i]) + 1);
+                history.valid = false;
+            }
+        }
+
+        // The source is converted before the upscale, the output after it unless the resize does it. Copied planes are converted directly.
+        const bool convert_source{ output_bits > p.bits };
+        const bool convert_output{ output_bits < p.bits && !resized };
+
+        if (output_bits != p.bits)
+            d->convert = make_convert(p.bits, output_bits, p.dither);
+
+        d->tm = tm << (bits - p.bits);
+        d->kernels = select_kernels(p.opt, component_size, p.edge);
+        d->layout = plan_layout(p.width, p.height, component_size, p.factor, (resized) ? target_width : 0, (resized) ? target_height : 0,
+            convert_source, (convert_output || cropped) && !resized);
+        // Every thread working on a frame has its own windows.
+        d->threads = resolve_threads(p.threads);
+        d->stats = !!p.stats;
+        d->trace = trace_recorder::from_environment();
+        d->frames = 0;
+        d->pool = std::make_unique<thread_pool>(d->threads);
+        d->scratch = std::make_unique<scratch_pool>(d->layout.size * d->threads);
+
+        return d.release();
+    }
+    catch (const std::exception& e)
+    {
+        return fail(e.what());
+    }
+}
+
+void fcbi_free(fcbi_context* context)
+{
+    if (context && context->trace)
+        context->trace->write();
+
+    delete context;
+}
+
+int fcbi_output_width(const fcbi_context* context, int plane)
+{
+    return (plane >= 0 && plane < context->num_planes) ? context->output_width[plane] : 0;
+}
+
+int fcbi_output_height(const fcbi_context* context, int plane)
+{
+    return (plane >= 0 && plane < context->num_planes) ? context->output_height[plane] : 0;
+}
+
+static fcbi_plane make_plane(const fcbi_context* d, const int plane, const uint8_t* srcp, const ptrdiff_t spitch, uint8_t* dstp,
+    const ptrdiff_t dpitch) noexcept
+{
+    const bool resized{ !!d->resize[plane].horizontal };
+    const bool converted{ d->convert.source || d->convert.output };
+
+    // A copied plane is cropped by reading the source rectangle.
+    if (d->mode[plane] == plane_mode::copy)
+        return { srcp + d->crop_y[plane] * spitch + static_cast<ptrdiff_t>(d->crop_x[plane]) * d->source_size, static_cast<int>(spitch),
+            d->output_width[plane], d->output_height[plane], dstp, static_cast<int>(dpitch), nullptr, (converted) ? &d->convert : nullptr, plane_mode::copy,
+            d->crop_x[plane], d->crop_y[plane] };
+
+    // The crop of a resized plane is in its resize.
+    const bool cropped{ !resized && (d->crop_x[plane] || d->crop_y[plane] || d->output_width[plane] != d->width[plane] << d->layout.stages ||
+        d->output_height[plane] != d->height[plane] << d->layout.stages) };
+
+    return { srcp, static_cast<int>(spitch), d->width[plane], d->height[plane], dstp, static_cast<int>(dpitch), (resized) ? &d->resize[plane] : nullptr,
+        (converted) ? &d->convert : nullptr, d->mode[plane], d->crop_x[plane], d->crop_y[plane], (cropped) ? d->output_width[plane] : 0,
+        (cropped) ? d->output_height[plane] : 0 };
+}
+
+// The history of plane, unless it has none or another frame holds it. lock holds it until the frame is done.
+static fcbi_history* lock_history(fcbi_context* d, const int plane, std::unique_lock<std::mutex>& lock) noexcept
+{
+    if (d->history[plane].source.empty())
+        return nullptr;
+
+    lock = std::unique_lock<std::mutex>{ d->history_lock[plane], std::try_to_lock };
+
+    return (lock.owns_lock()) ? &d->history[plane] : nullptr;
+}
+
+static int process(fcbi_context* d, const fcbi_plane* planes, const int num_planes) noexcept
+{
+    try
+    {
+        const auto start{ std::chrono::steady_clock::now() };
+        const int64_t frame{ (d->trace) ? d->frames++ : 0 };
+        fcbi_timing timing{};
+
+        process_frame(planes, num_planes, *d->scratch, d->layout, d->tm, d->threads, *d->pool, d->kernels, (d->stats) ? &timing : nullptr,
+            d->trace.get(), frame);
+
+        if (d->trace)
+            d->trace->span("frame", start, std::chrono::steady_clock::now(), frame, -1);
+
+        last_stats = {};
+
+        if (d->stats)
+        {
+            last_stats.phase1_us = timing.phase1 / 1000;
+            last_stats.phase2_us = timing.phase2 / 1000;
+            last_stats.phase3_us = timing.phase3 / 1000;
+            last_stats.output_us = timing.output / 1000;
+            last_stats.total_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        set_error(e.what());
+        return -1;
+    }
+}
+
+int fcbi_process_frame(fcbi_context* context, const uint8_t* const srcp[], const ptrdiff_t spitch[], uint8_t* const dstp[], const ptrdiff_t dpitch[])
+{
+    fcbi_plane planes[3];
+    std::unique_lock<std::mutex> locks[3];
+
+    for (int i{ 0 }; i < context->num_planes; ++i)
+    {
+        planes[i] = make_plane(context, i, srcp[i], spitch[i], dstp[i], dpitch[i]);
+        planes[i].history = lock_history(context, i, locks[i]);
+    }
+
+    return process(context, planes, context->num_planes);
+}
+
+int fcbi_process_plane(fcbi_context* context, int plane, const uint8_t* srcp, ptrdiff_t spitch, uint8_t* dstp, ptrdiff_t dpitch)
+{
+    if (plane < 0 || plane >= context->num_planes)
+    {
+        set_error("plane is out of range.");
+        return -1;
+    }
+
+    fcbi_plane args{ make_plane(context, plane, srcp, spitch, dstp, dpitch) };
+    std::unique_lock<std::mutex> lock;
+    args.history = lock_history(context, plane, lock);
+
+    return process(context, &args, 1);
+}
+
+void fcbi_last_stats(fcbi_stats* stats)
+{
+    *stats = last_stats;
+}
+
+int fcbi_max_opt(void)
+{
+    return max_opt();
+}
+
+const char* fcbi_last_error(void)
+{
+    return last_error.c_str();
+}
@@ -0,0 +1,129 @@
+/*
+ * C API of libfcbi_core, FCBI without a frameserver.
+ *
+ * A context is created once per format and processes any number of frames.
+ * It owns the kernels selected for the CPU, the scratch windows and the worker threads.
+ * fcbi_process_frame and fcbi_process_plane may be called from several threads at once on the same context.
+ */
+
+#ifndef FCBI_CORE_H
+#define FCBI_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(FCBI_CORE_EXPORTS)
+#define FCBI_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(FCBI_CORE_DLL)
+#define FCBI_API __declspec(dllimport)
+#elif defined(__GNUC__)
+#define FCBI_API __attribute__((visibility("default")))
+#else
+#define FCBI_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fcbi_context fcbi_context;
+
+typedef struct fcbi_params
+{
+    /* Size of the first plane of the source, at least 16x16. The output is factor times as wide and high. */
+    int width;
+    int height;
+    /* Bit depth of the source samples, 8..16, or 32 for float samples. 8-bit samples take one byte, 10..16-bit samples two. */
+    int bits;
+    /* 1 (luma only) or 3 (Y, U and V). */
+    int num_planes;
+    /* log2 of the chroma subsampling, 0 or 1. */
+    int subsampling_w;
+    int subsampling_h;
+    /* 2, 4 or 8. 4 and 8 cascade 2x stages without storing the intermediate frames. */
+    int factor;
+    /* Size the upscaled first plane is resized to strip by strip, 0 keeps factor * width/height.
+       At most factor * width/height and a multiple of the chroma subsampling. */
+    int target_width;
+    int target_height;
+    /* Re-centers the output on the source: source sample x lands on factor * x + (factor - 1) / 2 instead of factor * x,
+       like a resize with src_left/src_top = -(factor - 1) / 2. Done by the resize, which then runs even without a target size. */
+    int center;
+    /* Siting of the chroma samples for center, as _ChromaLocation: 0 left, 1 center, 2 top left, 3 top, 4 bottom left, 5 bottom. */
+    int chroma_location;
+    /* Bit depth of the output, 8..16 for integer clips, 0 keeps bits. A higher depth is upscaled at that depth, a lower one is rounded
+       or dithered after the upscale. Float clips can not be converted. */
+    int output_bits;
+    /* Use an ordered dither instead of rounding when output_bits is lower than bits. */
+    int dither;
+    /* How the chroma planes are brought to the output size: 0 FCBI, 1 bilinear on the same grid (much cheaper),
+       2 not at all, they keep the source size (the output subsampling grows by log2(factor)). 2 can not be combined with target_width/target_height,
+       and center then re-centers the first plane only. */
+    int chroma;
+    /* Samples removed from each side of the output (after the resize), only the remaining rectangle and the rows and columns around it
+       that it depends on are computed. Multiples of the chroma subsampling of the output. */
+    int crop_left;
+    int crop_top;
+    int crop_right;
+    int crop_bottom;
+    /* Keeps the source and output of the last frame and only upscales the output rows whose source rows changed, the others are copied
+       from the last output. For mostly static sources such as screen recordings and slideshows. A frame processed while another one
+       holds the last frame of a plane is upscaled whole. */
+    int reuse;
+    /* Measures every frame, see fcbi_last_stats(). */
+    int stats;
+    /* Use edge detection. */
+    int edge;
+    /* Threshold for edge detection, 0..2^bits-1 (0..255 for float), -1 selects 30 * (2^bits - 1) / 255. */
+    int tm;
+    /* -1: auto-detect, 0: C, 1: SSE2, 2: AVX2, 3: AVX512. */
+    int opt;
+    /* Threads working on a single frame, 0 uses every logical core. */
+    int threads;
+} fcbi_params;
+
+typedef struct fcbi_stats
+{
+    /* Microseconds spent in phase1 (the bilinear kernel for chroma=1), phase2 and phase3, summed over the threads working on the frame. */
+    int64_t phase1_us;
+    int64_t phase2_us;
+    int64_t phase3_us;
+    /* Microseconds spent in the rest of the work: the resize, bit depth conversion, crop and copies, and the checks for constant planes and reuse. */
+    int64_t output_us;
+    /* Wall time of the call in microseconds. */
+    int64_t total_us;
+} fcbi_stats;
+
+/* Fills params with the defaults: factor 2, no resize, center shift or bit depth conversion, FCBI on every plane, no crop, no reuse, no stats, no edge detection, tm -1, opt -1 and one thread. The format fields are zero. */
+FCBI_API void fcbi_default_params(fcbi_params* params);
+
+/* Returns NULL when params are invalid or resources can not be allocated, fcbi_last_error() tells why. */
+FCBI_API fcbi_context* fcbi_create(const fcbi_params* params);
+
+FCBI_API void fcbi_free(fcbi_context* context);
+
+/* Size of plane of the output, or 0 for a plane the context does not have. */
+FCBI_API int fcbi_output_width(const fcbi_context* context, int plane);
+FCBI_API int fcbi_output_height(const fcbi_context* context, int plane);
+
+/* Upscales num_planes planes. Strides are in bytes. Returns 0 on success and -1 on failure. */
+FCBI_API int fcbi_process_frame(fcbi_context* context, const uint8_t* const srcp[], const ptrdiff_t spitch[], uint8_t* const dstp[],
+    const ptrdiff_t dpitch[]);
+
+/* Upscales a single plane (0..num_planes-1). Returns 0 on success and -1 on failure. */
+FCBI_API int fcbi_process_plane(fcbi_context* context, int plane, const uint8_t* srcp, ptrdiff_t spitch, uint8_t* dstp, ptrdiff_t dpitch);
+
+/* Stats of the last successful fcbi_process_frame or fcbi_process_plane call on this thread, all zero unless the context was created with stats. */
+FCBI_API void fcbi_last_stats(fcbi_stats* stats);
+
+/* Highest opt level supported by the CPU. */
+FCBI_API int fcbi_max_opt(void);
+
+/* Message of the last failed call on this thread. */
+FCBI_API const char* fcbi_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
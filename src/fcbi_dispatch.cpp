@@ -0,0 +1,70 @@
+#include "fcbi.h"
+#include "VCL2/instrset.h"
+
+// One entry per opt level, sample size and edge setting; adding a kernel set means changing this file only.
+struct kernel_registry
+{
+    int max_opt;
+    // [opt][8-bit, 16-bit, float][edge]
+    fcbi_kernels kernels[4][3][2];
+
+    kernel_registry() noexcept;
+};
+
+template <typename T, bool EDGE>
+static void register_kernels(fcbi_kernels (&k)[4][3][2], const int iset) noexcept
+{
+    constexpr int size{ (std::is_same_v<T, uint16_t>) ? 1 : (std::is_same_v<T, float>) ? 2 : 0 };
+
+    k[0][size][EDGE] = { phase1_c<T>, phase2_c<T, EDGE>, phase3_c<T, EDGE>, bilinear_c<T> };
+    k[1][size][EDGE] = { phase1_sse2<T>, phase2_sse2<T, EDGE>, phase3_sse2<T, EDGE>, bilinear_sse2<T> };
+
+    // Only the 32-bit lanes of 10..16-bit clips gain from SSE4.1 (abs and blend).
+    if constexpr (std::is_same_v<T, uint16_t>)
+    {
+        if (iset >= 5)
+            k[1][size][EDGE] = { phase1_sse2<T>, phase2_sse41<T, EDGE>, phase3_sse41<T, EDGE>, bilinear_sse2<T> };
+    }
+
+    k[2][size][EDGE] = { phase1_avx2<T>, phase2_avx2<T, EDGE>, phase3_avx2<T, EDGE>, bilinear_avx2<T> };
+    k[3][size][EDGE] = { phase1_avx512<T>, phase2_avx512<T, EDGE>, phase3_avx512<T, EDGE>, bilinear_avx512<T> };
+}
+
+kernel_registry::kernel_registry() noexcept
+{
+    const int iset{ instrset_detect() };
+
+    max_opt = (iset >= 10) ? 3 : (iset >= 8) ? 2 : (iset >= 2) ? 1 : 0;
+
+    register_kernels<uint8_t, false>(kernels, iset);
+    register_kernels<uint8_t, true>(kernels, iset);
+    register_kernels<uint16_t, false>(kernels, iset);
+    register_kernels<uint16_t, true>(kernels, iset);
+    register_kernels<float, false>(kernels, iset);
+    register_kernels<float, true>(kernels, iset);
+}
+
+static const kernel_registry& registry() noexcept
+{
+    static const kernel_registry r;
+    return r;
+}
+
+int max_opt() noexcept
+{
+    return registry().max_opt;
+}
+
+const char* opt_requirement(const int opt) noexcept
+{
+    static const char* const requirements[]{ "", "SSE2", "AVX2", "AVX512F, AVX512BW, AVX512DQ and AVX512VL" };
+
+    return requirements[opt];
+}
+
+const fcbi_kernels& select_kernels(const int opt, const int component_size, const bool edge) noexcept
+{
+    const kernel_registry& r{ registry() };
+
+    return r.kernels[(opt == -1) ? r.max_opt : opt][component_size / 2][edge];
+}
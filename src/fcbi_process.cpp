@@ -0,0 +1,658 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "fcbi.h"
+#include "fcbi_thread_pool.h"
+#include "fcbi_trace.h"
+
+// What is recorded of the band the thread is working on, only set while process_frame measures or traces.
+struct band_probe
+{
+    fcbi_timing* timing;
+    trace_recorder* trace;
+    int64_t frame;
+    int plane;
+};
+
+static thread_local const band_probe* probe{ nullptr };
+
+static int64_t elapsed(const std::chrono::steady_clock::time_point start) noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Calls f, adds its duration to counter of the band timing and records it as a span named name, if the band is measured or traced.
+template <typename F>
+static void timed(int64_t fcbi_timing::* counter, const char* name, F&& f) noexcept
+{
+    if (!probe)
+    {
+        f();
+        return;
+    }
+
+    const auto start{ std::chrono::steady_clock::now() };
+    f();
+    const auto end{ std::chrono::steady_clock::now() };
+
+    if (probe->timing)
+        probe->timing->*counter += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    if (probe->trace)
+        probe->trace->span(name, start, end, probe->frame, probe->plane);
+}
+
+int strip_height(const int row_size, const int height, const int parts) noexcept
+{
+    constexpr int l2_budget{ 512 * 1024 };
+
+    return std::min(std::max(l2_budget / parts / row_size, 16) & ~1, height);
+}
+
+void process_plane(const uint8_t* srcp, const int spitch, const int width, const int height, uint8_t* __restrict dstp, const int dpitch,
+    uint8_t* __restrict wndp, const int wpitch, const int strip, const int tm, const int top, const int bottom,
+    const fcbi_kernels& kernels) noexcept
+{
+    const int dwidth{ 2 * width };
+    const int dheight{ 2 * height };
+    // The first window row only holds the left padding of the second one.
+    const int capacity{ strip + strip_halo - 1 };
+
+    // Output row y lives at row (y - wtop + 1) of the window.
+    // A band below the top of the plane starts four rows early, so that phase2 and phase3 have the rows above it.
+    int wtop{ std::max(top - 4, 0) };
+    const auto row{ [&](const int y) noexcept { return wndp + static_cast<ptrdiff_t>(y - wtop + 1) * wpitch; } };
+
+    // Next source row for phase1 and next output row for phase2.
+    // phase2 reads three rows above its own, which are not in the window for the first rows of a band.
+    int src_y{ wtop / 2 };
+    int p2_y{ (wtop > 0) ? wtop + 2 : 0 };
+
+    for (int y{ top }; y < bottom; y += strip)
+    {
+        const int strip_bottom{ std::min(y + strip, bottom) };
+
+        // phase3 reads two rows around its own, phase2 three, and phase1 writes two more rows after the last source row.
+        if (strip_bottom + 7 - wtop > capacity)
+        {
+            const int keep{ y - 2 };
+            memmove(wndp, row(keep - 1), static_cast<size_t>(2 * src_y - keep + 2) * wpitch);
+            wtop = keep;
+        }
+
+        const int src_bottom{ std::min((strip_bottom + 6) / 2, height) };
+        if (src_bottom > src_y)
+        {
+            timed(&fcbi_timing::phase1, "phase1", [&] { kernels.phase1(srcp + static_cast<ptrdiff_t>(src_y) * spitch, row(2 * src_y), width, height, spitch,
+                wpitch, src_y, src_bottom); });
+            src_y = src_bottom;
+        }
+
+        const int p2_bottom{ std::min(strip_bottom + 2, dheight) };
+        timed(&fcbi_timing::phase2, "phase2", [&] { kernels.phase2(row(p2_y), dwidth, dheight, wpitch, tm, p2_y, p2_bottom); });
+        p2_y = p2_bottom;
+
+        timed(&fcbi_timing::phase3, "phase3", [&] { kernels.phase3(row(y), dstp + static_cast<ptrdiff_t>(y) * dpitch, dwidth, dheight, wpitch, dpitch, tm, y,
+            strip_bottom); });
+    }
+}
+
+fcbi_layout plan_layout(const int width, const int height, const int component_size, const int factor, const int target_width,
+    const int target_height, const bool convert_source, const bool buffer_output) noexcept
+{
+    fcbi_layout layout{};
+    layout.stages = (factor == 8) ? 3 : (factor == 4) ? 2 : 1;
+    layout.component_size = component_size;
+
+    size_t size{ 0 };
+    // The windows of the stages and the buffers between them are used together, so they share the budget.
+    const int parts{ 2 * layout.stages - ((convert_source) ? 0 : 1) };
+
+    for (int k{ 0 }; k < layout.stages; ++k)
+    {
+        const int swidth{ width << k };
+        const int dwidth{ width << (k + 1) };
+        const int dheight{ height << (k + 1) };
+
+        // Window rows start on cache lines.
+        layout.wpitch[k] = ((dwidth + 4) * component_size + 63) & ~63;
+        // The window only holds one strip of the plane at a time.
+        layout.strip[k] = strip_height(layout.wpitch[k], dheight, parts);
+        layout.window[k] = size;
+        size += static_cast<size_t>(layout.strip[k] + strip_halo) * layout.wpitch[k];
+
+        if (k > 0 || convert_source)
+        {
+            // A chunk of 2n rows reads at most n + 7 rows of the previous stage, see cascade().
+            layout.ipitch[k] = (swidth * component_size + 63) & ~63;
+            layout.chunk[k] = 2 * strip_height(layout.ipitch[k], dheight, parts);
+            layout.buffer[k] = size;
+            size += static_cast<size_t>(layout.chunk[k] / 2 + 8) * layout.ipitch[k];
+        }
+    }
+
+    const int uwidth{ width * factor };
+    const int uheight{ height * factor };
+
+    if (target_width && target_height)
+    {
+        // The first and last rows of a chunk are rounded to even rows, see resize_band().
+        layout.rpitch = (uwidth * component_size + 63) & ~63;
+        layout.rrows = (std::max(strip_height(layout.rpitch, uheight), resize_taps(uheight, target_height) + 2) + 1) & ~1;
+        layout.rbuffer = size;
+        size += static_cast<size_t>(layout.rrows) * layout.rpitch;
+
+        layout.hpitch = (target_width * static_cast<int>(sizeof(float)) + 63) & ~63;
+        layout.hbuffer = size;
+        size += static_cast<size_t>(layout.rrows) * layout.hpitch;
+    }
+    else if (buffer_output)
+    {
+        // A chunk reads its rows widened to even rows, see output_band().
+        const int k{ layout.stages };
+
+        layout.ipitch[k] = (uwidth * component_size + 63) & ~63;
+        layout.chunk[k] = strip_height(layout.ipitch[k], uheight);
+        layout.buffer[k] = size;
+        size += static_cast<size_t>(layout.chunk[k] + 2) * layout.ipitch[k];
+    }
+
+    layout.size = size;
+
+    return layout;
+}
+
+// Runs one 2x stage of plane on the rows [top, bottom), with the three phases or the bilinear kernel.
+static void upscale(const fcbi_plane& plane, const uint8_t* srcp, const int spitch, const int width, const int height, uint8_t* dstp, const int dpitch,
+    uint8_t* wndp, const int wpitch, const int strip, const int tm, const int top, const int bottom, const fcbi_kernels& kernels) noexcept
+{
+    if (plane.mode == plane_mode::bilinear)
+        timed(&fcbi_timing::phase1, "bilinear", [&] { kernels.bilinear(srcp + static_cast<ptrdiff_t>(top / 2) * spitch, dstp + static_cast<ptrdiff_t>(top) * dpitch,
+            width, height, spitch, dpitch, top, bottom); });
+    else
+        process_plane(srcp, spitch, width, height, dstp, dpitch, wndp, wpitch, strip, tm, top, bottom, kernels);
+}
+
+// Writes the output rows [top, bottom) of stage k of plane to dstp, which holds row y at dstp + y * dpitch, and at least the columns [left, right).
+// Stage k reads the output of stage k - 1, which is computed a chunk at a time into the buffer between them.
+// Stage 0 reads the source, through the buffer when the source is converted.
+// Only the source columns that [left, right) depends on are processed, as a narrower plane starting at column x0.
+static void cascade(const fcbi_plane& plane, const fcbi_layout& layout, uint8_t* scratch, const int k, uint8_t* dstp, const int dpitch,
+    const int top, const int bottom, const int left, const int right, const int tm, const fcbi_kernels& kernels) noexcept
+{
+    const int width{ plane.width << k };
+    const int height{ plane.height << k };
+    const int size{ layout.component_size };
+    uint8_t* wndp{ scratch + layout.window[k] };
+
+    int x0{ std::max(left / 2 - crop_halo, 0) };
+    int x1{ std::min((right + 1) / 2 + crop_halo, width) };
+    if (x1 - x0 < 16)
+    {
+        x1 = std::min(x0 + 16, width);
+        x0 = std::max(x1 - 16, 0);
+    }
+
+    dstp += static_cast<ptrdiff_t>(2 * x0) * size;
+
+    if (k == 0 && !(plane.convert && plane.convert->source))
+    {
+        upscale(plane, plane.srcp + static_cast<ptrdiff_t>(x0) * size, plane.spitch, x1 - x0, height, dstp, dpitch, wndp, layout.wpitch[0],
+            layout.strip[0], tm, top, bottom, kernels);
+        return;
+    }
+
+    const int ipitch{ layout.ipitch[k] };
+    uint8_t* buffer{ scratch + layout.buffer[k] };
+    // Rows of the previous stage held by the buffer. The rows a chunk shares with the last one are moved to the top of the buffer
+    // instead of being computed again.
+    int held_first{ 0 };
+    int held_last{ 0 };
+
+    for (int y{ top }; y < bottom; y += layout.chunk[k])
+    {
+        const int chunk_bottom{ std::min(y + layout.chunk[k], bottom) };
+
+        // The source rows process_plane reads for [y, chunk_bottom), widened to even rows for the previous stage.
+        const int first{ (std::max(y - 4, 0) / 2) & ~1 };
+        const int last{ std::min((std::min((chunk_bottom + 6) / 2, height) + 1) & ~1, height) };
+        int from{ first };
+
+        if (first >= held_first && first < held_last)
+        {
+            memmove(buffer, buffer + static_cast<ptrdiff_t>(first - held_first) * ipitch, static_cast<size_t>(held_last - first) * ipitch);
+            from = held_last;
+        }
+
+        held_first = first;
+        held_last = last;
+
+        // Row first of the previous stage is the first row of the buffer.
+        uint8_t* rows{ buffer - static_cast<ptrdiff_t>(first) * ipitch };
+
+        if (k == 0)
+            plane.convert->source(plane.srcp + static_cast<ptrdiff_t>(from) * plane.spitch, plane.spitch, rows + static_cast<ptrdiff_t>(from) * ipitch,
+                ipitch, plane.width, last - from, plane.convert->shift);
+        else if (from < last)
+            cascade(plane, layout, scratch, k - 1, rows, ipitch, from, last, x0, x1, tm, kernels);
+
+        upscale(plane, rows + static_cast<ptrdiff_t>(x0) * size, ipitch, x1 - x0, height, dstp, dpitch, wndp, layout.wpitch[k], layout.strip[k], tm,
+            y, chunk_bottom, kernels);
+    }
+}
+
+// Writes the rows [top, bottom) of the resized plane.
+// The upscaled rows read by a chunk of output rows are computed into the row buffer, filtered horizontally into the float buffer
+// and then vertically into dstp.
+static void resize_band(const fcbi_plane& plane, const fcbi_layout& layout, uint8_t* scratch, const int top, const int bottom, const int tm,
+    const fcbi_kernels& kernels) noexcept
+{
+    const fcbi_resize& resize{ *plane.resize };
+    const int uheight{ plane.height << layout.stages };
+    const int taps{ resize.y.taps };
+    const int hpitch{ layout.hpitch / static_cast<int>(sizeof(float)) };
+    float* hbuf{ reinterpret_cast<float*>(scratch + layout.hbuffer) };
+    // Upscaled columns read by the output columns, fewer than the plane when the resize is cropped.
+    const int left{ resize.x.first.front() };
+    const int right{ resize.x.first.back() + resize.x.taps };
+
+    for (int y{ top }; y < bottom;)
+    {
+        // process_plane starts on even rows.
+        const int first{ resize.y.first[y] & ~1 };
+
+        int next{ y + 1 };
+        while (next < bottom && resize.y.first[next] + taps + 1 - first <= layout.rrows)
+            ++next;
+
+        const int last{ std::min((resize.y.first[next - 1] + taps + 1) & ~1, uheight) };
+        uint8_t* rows{ scratch + layout.rbuffer - static_cast<ptrdiff_t>(first) * layout.rpitch };
+
+        cascade(plane, layout, scratch, layout.stages - 1, rows, layout.rpitch, first, last, left, right, tm, kernels);
+        resize.horizontal(scratch + layout.rbuffer, layout.rpitch, hbuf, hpitch, last - first, resize.x);
+
+        for (int i{ y }; i < next; ++i)
+            resize.vertical(hbuf + static_cast<ptrdiff_t>(resize.y.first[i] - first) * hpitch, hpitch, plane.dstp + static_cast<ptrdiff_t>(i) * plane.dpitch,
+                i, resize);
+
+        y = next;
+    }
+}
+
+// Writes the rows [top, bottom) of the upscaled plane, converted to the output depth or cropped, a chunk at a time through the output buffer.
+// The stages compute even rows only, so a chunk computes its rows widened to even rows.
+static void output_band(const fcbi_plane& plane, const fcbi_layout& layout, uint8_t* scratch, const int top, const int bottom, const int tm,
+    const fcbi_kernels& kernels) noexcept
+{
+    const int k{ layout.stages };
+    const int ipitch{ layout.ipitch[k] };
+    const int uheight{ plane.height << k };
+    const int width{ (plane.crop_width) ? plane.crop_width : plane.width << k };
+    uint8_t* buffer{ scratch + layout.buffer[k] };
+
+    for (int y{ top }; y < bottom; y += layout.chunk[k])
+    {
+        const int chunk_bottom{ std::min(y + layout.chunk[k], bottom) };
+        const int first{ y & ~1 };
+        const int last{ std::min((chunk_bottom + 1) & ~1, uheight) };
+
+        cascade(plane, layout, scratch, k - 1, buffer - static_cast<ptrdiff_t>(first) * ipitch, ipitch, first, last, plane.crop_x, plane.crop_x + width,
+            tm, kernels);
+
+        const uint8_t* srcp{ buffer + static_cast<ptrdiff_t>(y - first) * ipitch + static_cast<ptrdiff_t>(plane.crop_x) * layout.component_size };
+        uint8_t* dstp{ plane.dstp + static_cast<ptrdiff_t>(y - plane.crop_y) * plane.dpitch };
+
+        if (plane.convert && plane.convert->output)
+            plane.convert->output(srcp, ipitch, dstp, plane.dpitch, width, plane.crop_x, y, chunk_bottom - y, *plane.convert);
+        else
+        {
+            for (int i{ y }; i < chunk_bottom; ++i)
+            {
+                memcpy(dstp, srcp, static_cast<size_t>(width) * layout.component_size);
+                srcp += ipitch;
+                dstp += plane.dpitch;
+            }
+        }
+    }
+}
+
+// True when every source sample of plane is the same, every stage then gives that value everywhere.
+// Float samples whose double overflows are not, as the averages of the kernels change them.
+static bool constant_plane(const fcbi_plane& plane, const int size) noexcept
+{
+    const size_t row{ static_cast<size_t>(plane.width) * size };
+
+    // The first row equals itself shifted by a sample, and every other row equals the first one.
+    if (memcmp(plane.srcp, plane.srcp + size, row - size))
+        return false;
+
+    for (int y{ 1 }; y < plane.height; ++y)
+    {
+        if (memcmp(plane.srcp + static_cast<ptrdiff_t>(y) * plane.spitch, plane.srcp, row))
+            return false;
+    }
+
+    if (size == 4)
+    {
+        float v;
+        memcpy(&v, plane.srcp, sizeof(v));
+        return std::abs(v) <= std::numeric_limits<float>::max() / 2;
+    }
+
+    return true;
+}
+
+// Writes the rows [top, bottom) of a constant plane (see constant_plane()), which are resized or converted like those of the upscale.
+// top and bottom are rows of the uncropped plane unless it is resized, as in output_band() and resize_band().
+// A single upscaled row stands for all of them, the vertical resize reads it for every tap.
+static void fill_band(const fcbi_plane& plane, const fcbi_layout& layout, uint8_t* scratch, const int top, const int bottom) noexcept
+{
+    const int size{ layout.component_size };
+    const int uwidth{ plane.width << layout.stages };
+    uint8_t* row{ scratch + layout.window[layout.stages - 1] };
+
+    if (plane.convert && plane.convert->source)
+        plane.convert->source(plane.srcp, plane.spitch, row, 0, 1, 1, plane.convert->shift);
+    else
+        memcpy(row, plane.srcp, size);
+
+    for (int n{ 1 }; n < uwidth; n *= 2)
+        memcpy(row + static_cast<ptrdiff_t>(n) * size, row, static_cast<size_t>(std::min(n, uwidth - n)) * size);
+
+    if (plane.resize)
+    {
+        float* hbuf{ reinterpret_cast<float*>(scratch + layout.hbuffer) };
+
+        plane.resize->horizontal(row, 0, hbuf, 0, 1, plane.resize->x);
+
+        for (int y{ top }; y < bottom; ++y)
+            plane.resize->vertical(hbuf, 0, plane.dstp + static_cast<ptrdiff_t>(y) * plane.dpitch, y, *plane.resize);
+
+        return;
+    }
+
+    const int width{ (plane.crop_width) ? plane.crop_width : uwidth };
+    uint8_t* dstp{ plane.dstp + static_cast<ptrdiff_t>(top - plane.crop_y) * plane.dpitch };
+
+    if (plane.convert && plane.convert->output)
+        plane.convert->output(row, 0, dstp, plane.dpitch, width, plane.crop_x, top, bottom - top, *plane.convert);
+    else
+    {
+        for (int y{ top }; y < bottom; ++y)
+        {
+            memcpy(dstp, row, static_cast<size_t>(width) * size);
+            dstp += plane.dpitch;
+        }
+    }
+}
+
+// Copies the rows [top, bottom) of a plane that is not upscaled, converted to the output depth if needed.
+static void copy_band(const fcbi_plane& plane, const fcbi_layout& layout, const int top, const int bottom) noexcept
+{
+    const uint8_t* srcp{ plane.srcp + static_cast<ptrdiff_t>(top) * plane.spitch };
+    uint8_t* dstp{ plane.dstp + static_cast<ptrdiff_t>(top) * plane.dpitch };
+
+    if (plane.convert && plane.convert->source)
+        plane.convert->source(srcp, plane.spitch, dstp, plane.dpitch, plane.width, bottom - top, plane.convert->shift);
+    else if (plane.convert)
+        plane.convert->output(srcp, plane.spitch, dstp, plane.dpitch, plane.width, plane.crop_x, plane.crop_y + top, bottom - top, *plane.convert);
+    else
+    {
+        for (int y{ top }; y < bottom; ++y)
+        {
+            memcpy(dstp, srcp, static_cast<size_t>(plane.width) * layout.component_size);
+            srcp += plane.spitch;
+            dstp += plane.dpitch;
+        }
+    }
+}
+
+// Rows of dstp written for plane.
+static int output_rows(const fcbi_plane& plane, const fcbi_layout& layout) noexcept
+{
+    if (plane.mode == plane_mode::copy)
+        return plane.height;
+    if (plane.resize)
+        return static_cast<int>(plane.resize->y.first.size());
+
+    return (plane.crop_width) ? plane.crop_height : plane.height << layout.stages;
+}
+
+// Bytes per source sample of plane.
+static int source_size(const fcbi_plane& plane, const fcbi_layout& layout) noexcept
+{
+    return (plane.convert && plane.convert->source) ? plane.convert->source_size : layout.component_size;
+}
+
+// Writes the output rows [top, bottom) of plane, rows of dstp.
+static void process_rows(const fcbi_plane& plane, const bool constant, const fcbi_layout& layout, uint8_t* scratch, const int top, const int bottom,
+    const int tm, const fcbi_kernels& kernels) noexcept
+{
+    if (plane.mode == plane_mode::copy)
+        copy_band(plane, layout, top, bottom);
+    else if (plane.resize)
+    {
+        if (constant)
+            fill_band(plane, layout, scratch, top, bottom);
+        else
+            resize_band(plane, layout, scratch, top, bottom, tm, kernels);
+    }
+    else
+    {
+        const int uwidth{ plane.width << layout.stages };
+        const int width{ (plane.crop_width) ? plane.crop_width : uwidth };
+        const int first{ plane.crop_y + top };
+        const int last{ plane.crop_y + bottom };
+        // Whole rows starting and ending on even rows are written straight to dstp.
+        const bool direct{ !(plane.convert && plane.convert->output) && width == uwidth && !(first & 1) && !(last & 1) };
+
+        if (constant)
+            fill_band(plane, layout, scratch, first, last);
+        else if (direct)
+            cascade(plane, layout, scratch, layout.stages - 1, plane.dstp - static_cast<ptrdiff_t>(plane.crop_y) * plane.dpitch, plane.dpitch, first, last, 0,
+                uwidth, tm, kernels);
+        else
+            output_band(plane, layout, scratch, first, last, tm, kernels);
+    }
+}
+
+// Source rows [first, last) that the output rows [top, bottom) of plane are computed from, the rows cascade() and resize_band() read.
+static void source_rows(const fcbi_plane& plane, const fcbi_layout& layout, const int top, const int bottom, int& first, int& last) noexcept
+{
+    const int uheight{ plane.height << layout.stages };
+
+    if (plane.resize)
+    {
+        first = plane.resize->y.first[top] & ~1;
+        last = std::min((plane.resize->y.first[bottom - 1] + plane.resize->y.taps + 1) & ~1, uheight);
+    }
+    else
+    {
+        first = (plane.crop_y + top) & ~1;
+        last = std::min((plane.crop_y + bottom + 1) & ~1, uheight);
+    }
+
+    for (int k{ layout.stages - 1 }; k >= 0; --k)
+    {
+        const int height{ plane.height << k };
+
+        first = (std::max(first - 4, 0) / 2) & ~1;
+        last = std::min((std::min((last + 6) / 2, height) + 1) & ~1, height);
+    }
+}
+
+// Counts the source rows of plane that differ from those of its history.
+static void compare_history(const fcbi_plane& plane, fcbi_history& history) noexcept
+{
+    history.changed[0] = 0;
+
+    for (int y{ 0 }; y < plane.height; ++y)
+    {
+        const bool changed{ !history.valid || !!memcmp(plane.srcp + static_cast<ptrdiff_t>(y) * plane.spitch,
+            history.source.data() + static_cast<size_t>(y) * history.source_row, history.source_row) };
+
+        history.changed[y + 1] = history.changed[y] + changed;
+    }
+}
+
+// Stores the source rows of plane that changed in its history.
+static void update_history(const fcbi_plane& plane, fcbi_history& history) noexcept
+{
+    for (int y{ 0 }; y < plane.height; ++y)
+    {
+        if (history.changed[y + 1] != history.changed[y])
+            memcpy(history.source.data() + static_cast<size_t>(y) * history.source_row, plane.srcp + static_cast<ptrdiff_t>(y) * plane.spitch,
+                history.source_row);
+    }
+
+    history.valid = true;
+}
+
+// Writes the output rows [top, bottom) of a plane with a history, a tile of rows at a time. Tiles whose source rows did not change are copied
+// from the output of the history, runs of the other ones are computed and stored in it.
+static void reuse_rows(const fcbi_plane& plane, const bool constant, const fcbi_layout& layout, uint8_t* scratch, const int top, const int bottom,
+    const int tm, const fcbi_kernels& kernels) noexcept
+{
+    fcbi_history& history{ *plane.history };
+
+    for (int y{ top }; y < bottom;)
+    {
+        // Consecutive tiles that are both changed or both unchanged are handled together.
+        int next{ y };
+        bool changed{ false };
+
+        do
+        {
+            const int tile_bottom{ std::min(next + reuse_tile, bottom) };
+            int first;
+            int last;
+            source_rows(plane, layout, next, tile_bottom, first, last);
+
+            const bool tile_changed{ history.changed[last] != history.changed[first] };
+
+            if (next > y && tile_changed != changed)
+                break;
+
+            changed = tile_changed;
+            next = tile_bottom;
+        } while (next < bottom);
+
+        uint8_t* dstp{ plane.dstp + static_cast<ptrdiff_t>(y) * plane.dpitch };
+        uint8_t* stored{ history.output.data() + static_cast<size_t>(y) * history.output_row };
+
+        if (changed)
+            process_rows(plane, constant, layout, scratch, y, next, tm, kernels);
+
+        for (int i{ y }; i < next; ++i)
+        {
+            if (changed)
+                memcpy(stored, dstp, history.output_row);
+            else
+                memcpy(dstp, stored, history.output_row);
+
+            dstp += plane.dpitch;
+            stored += history.output_row;
+        }
+
+        y = next;
+    }
+}
+
+void process_frame(const fcbi_plane* planes, const int num_planes, scratch_pool& scratch, const fcbi_layout& layout, const int tm,
+    const int threads, thread_pool& pool, const fcbi_kernels& kernels, fcbi_timing* timing, trace_recorder* trace, const int64_t frame)
+{
+    auto start{ std::chrono::steady_clock::now() };
+
+    // The bands of all planes are queued together, so that chroma is processed alongside luma.
+    // Bands are at least 16 output rows high, a resized, copied or cropped plane smaller than that is a single band.
+    int first[4]{};
+    // Constant planes, such as black frames, skip the upscale.
+    bool constant[3]{};
+    for (int p{ 0 }; p < num_planes; ++p)
+    {
+        const fcbi_plane& plane{ planes[p] };
+        constant[p] = plane.mode != plane_mode::copy && constant_plane(plane, source_size(plane, layout));
+        const int height{ (plane.resize || plane.mode == plane_mode::copy || plane.crop_width) ? output_rows(plane, layout) / 2 :
+            output_rows(plane, layout) };
+        first[p + 1] = first[p] + std::max(std::min(threads, height / 8), 1);
+
+        if (plane.history)
+            compare_history(plane, *plane.history);
+    }
+
+    // Every thread sums the timing of its bands.
+    std::vector<fcbi_timing> slot_timing((timing) ? threads : 0);
+
+    if (timing)
+    {
+        *timing = {};
+        timing->output = elapsed(start);
+    }
+
+    // A thread reuses its scratch for all of its bands.
+    uint8_t* buffer{ scratch.acquire() };
+
+    pool.run(first[num_planes], [&](const int i, const int slot)
+    {
+        int p{ 0 };
+        while (i >= first[p + 1])
+            ++p;
+
+        const fcbi_plane& plane{ planes[p] };
+        const int bands{ first[p + 1] - first[p] };
+        const int band{ i - first[p] };
+        // Bands start on even rows, so that most of them can be written directly.
+        const int height{ output_rows(plane, layout) };
+        const int top{ (height * band / bands) & ~1 };
+        const int bottom{ (band + 1 == bands) ? height : (height * (band + 1) / bands) & ~1 };
+        const auto band_start{ std::chrono::steady_clock::now() };
+        fcbi_timing band_phases{};
+        const band_probe band_record{ (timing) ? &band_phases : nullptr, trace, frame, p };
+
+        if (timing || trace)
+            probe = &band_record;
+
+        if (plane.history)
+            reuse_rows(plane, constant[p], layout, buffer + slot * layout.size, top, bottom, tm, kernels);
+        else
+            process_rows(plane, constant[p], layout, buffer + slot * layout.size, top, bottom, tm, kernels);
+
+        probe = nullptr;
+
+        if (trace)
+            trace->span("band", band_start, std::chrono::steady_clock::now(), frame, p);
+
+        if (timing)
+        {
+            fcbi_timing& t{ slot_timing[slot] };
+            t.phase1 += band_phases.phase1;
+            t.phase2 += band_phases.phase2;
+            t.phase3 += band_phases.phase3;
+            t.output += elapsed(band_start) - band_phases.phase1 - band_phases.phase2 - band_phases.phase3;
+        }
+    });
+
+    scratch.release(buffer);
+    start = std::chrono::steady_clock::now();
+
+    for (int p{ 0 }; p < num_planes; ++p)
+    {
+        if (planes[p].history)
+            update_history(planes[p], *planes[p].history);
+    }
+
+    if (timing)
+    {
+        timing->output += elapsed(start);
+
+        for (const fcbi_timing& t : slot_timing)
+        {
+            timing->phase1 += t.phase1;
+            timing->phase2 += t.phase2;
+            timing->phase3 += t.phase3;
+            timing->output += t.output;
+        }
+    }
+}
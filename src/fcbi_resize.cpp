@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cmath>
+
+#include "fcbi.h"
+
+// Catmull-Rom cubic, x in units of input samples.
+static double cubic(double x) noexcept
+{
+    x = std::abs(x);
+
+    if (x < 1.0)
+        return (1.5 * x - 2.5) * x * x + 1.0;
+    if (x < 2.0)
+        return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+
+    return 0.0;
+}
+
+int resize_taps(const int src_size, const int dst_size) noexcept
+{
+    // The kernel is stretched by the ratio when downscaling, so that it does not alias.
+    const double scale{ std::max(static_cast<double>(src_size) / dst_size, 1.0) };
+
+    return std::min(static_cast<int>(std::ceil(4.0 * scale)) + 1, src_size);
+}
+
+fcbi_resize_axis resize_axis(const int src_size, const int dst_size, const double shift)
+{
+    fcbi_resize_axis axis;
+    axis.offset = 0;
+    axis.taps = (src_size == dst_size && shift == 0.0) ? 1 : resize_taps(src_size, dst_size);
+    axis.first.resize(dst_size);
+    axis.weights.assign(static_cast<size_t>(dst_size) * axis.taps, 0.0f);
+
+    const double ratio{ static_cast<double>(src_size) / dst_size };
+    const double scale{ std::max(ratio, 1.0) };
+    const double radius{ 2.0 * scale };
+    std::vector<double> acc(axis.taps);
+
+    for (int i{ 0 }; i < dst_size; ++i)
+    {
+        float* weights{ axis.weights.data() + static_cast<size_t>(i) * axis.taps };
+
+        if (axis.taps == 1)
+        {
+            axis.first[i] = i;
+            weights[0] = 1.0f;
+            continue;
+        }
+
+        // Centers of the output samples are aligned to the centers of the input samples.
+        const double center{ (i + 0.5) * ratio - 0.5 + shift };
+        const int lo{ static_cast<int>(std::ceil(center - radius)) };
+        const int hi{ static_cast<int>(std::floor(center + radius)) };
+
+        // Samples past the borders repeat the border sample, their weights go to the border inside the window.
+        axis.first[i] = std::clamp(lo, 0, src_size - axis.taps);
+
+        std::fill(acc.begin(), acc.end(), 0.0);
+        double sum{ 0.0 };
+
+        for (int j{ lo }; j <= hi; ++j)
+        {
+            const double c{ cubic((j - center) / scale) };
+            acc[std::clamp(j, 0, src_size - 1) - axis.first[i]] += c;
+            sum += c;
+        }
+
+        for (int t{ 0 }; t < axis.taps; ++t)
+            weights[t] = static_cast<float>(acc[t] / sum);
+    }
+
+    return axis;
+}
+
+void crop_axis(fcbi_resize_axis& axis, const int first, const int size)
+{
+    axis.offset += first;
+    axis.first.erase(axis.first.begin(), axis.first.begin() + first);
+    axis.first.resize(size);
+    axis.weights.erase(axis.weights.begin(), axis.weights.begin() + static_cast<ptrdiff_t>(first) * axis.taps);
+    axis.weights.resize(static_cast<size_t>(size) * axis.taps);
+}
+
+double center_shift(const int size, const int target_size, const int factor, const int ss, const double siting) noexcept
+{
+    // Output sample j sits at s * j + o on the output luma grid, which maps to the source luma grid through the pixel centers.
+    // Source chroma c sits at s * c + o on the source luma grid and at factor * c in the upscaled plane.
+    const int s{ 1 << ss };
+    const double o{ siting * (s - 1) };
+    const double ratio{ static_cast<double>(size) / target_size };
+
+    return (ratio - factor) * (o + 0.5) / s - 0.5 * ratio + 0.5;
+}
+
+template <typename T>
+static void resize_horizontal(const uint8_t* srcp_, const int spitch, float* __restrict dstp, const int dpitch, const int rows,
+    const fcbi_resize_axis& axis) noexcept
+{
+    const int width{ static_cast<int>(axis.first.size()) };
+    const int taps{ axis.taps };
+
+    for (int y{ 0 }; y < rows; ++y)
+    {
+        const T* srcp{ reinterpret_cast<const T*>(srcp_ + static_cast<ptrdiff_t>(y) * spitch) };
+        const float* weights{ axis.weights.data() };
+
+        for (int x{ 0 }; x < width; ++x)
+        {
+            const T* s{ srcp + axis.first[x] };
+            float sum{ 0.0f };
+
+            for (int t{ 0 }; t < taps; ++t)
+                sum += weights[t] * s[t];
+
+            dstp[x] = sum;
+            weights += taps;
+        }
+
+        dstp += dpitch;
+    }
+}
+
+template <typename T>
+static void resize_vertical(const float* srcp, const int spitch, uint8_t* __restrict dstp_, const int y, const fcbi_resize& resize) noexcept
+{
+    T* __restrict dstp{ reinterpret_cast<T*>(dstp_) };
+    const int width{ static_cast<int>(resize.x.first.size()) };
+    const int taps{ resize.y.taps };
+    const float* weights{ resize.y.weights.data() + static_cast<size_t>(y) * taps };
+
+    // Rounding offsets of the integer samples, x & 7 selects one.
+    float bias[8];
+    for (int x{ 0 }; x < 8; ++x)
+        bias[x] = (resize.dither) ? (dither_matrix[(resize.y.offset + y) & 7][(resize.x.offset + x) & 7] + 0.5f) / 64.0f : 0.5f;
+
+    // Blocks of columns are summed row by row, so that the inner loop runs over contiguous samples.
+    constexpr int block{ 256 };
+    float sum[block];
+
+    for (int x{ 0 }; x < width; x += block)
+    {
+        const int n{ std::min(block, width - x) };
+
+        for (int i{ 0 }; i < n; ++i)
+            sum[i] = weights[0] * srcp[x + i];
+
+        for (int t{ 1 }; t < taps; ++t)
+        {
+            const float* row{ srcp + static_cast<ptrdiff_t>(t) * spitch + x };
+
+            for (int i{ 0 }; i < n; ++i)
+                sum[i] += weights[t] * row[i];
+        }
+
+        for (int i{ 0 }; i < n; ++i)
+        {
+            if constexpr (std::is_floating_point_v<T>)
+                dstp[x + i] = sum[i];
+            else
+                dstp[x + i] = static_cast<T>(std::clamp(static_cast<int>(sum[i] * resize.scale + bias[(x + i) & 7]), 0, resize.peak));
+        }
+    }
+}
+
+fcbi_resize make_resize(const int src_width, const int src_height, const int dst_width, const int dst_height, const double shift_x,
+    const double shift_y, const int bits, const int output_bits, const bool dither)
+{
+    fcbi_resize resize;
+    resize.x = resize_axis(src_width, dst_width, shift_x);
+    resize.y = resize_axis(src_height, dst_height, shift_y);
+    resize.scale = (bits == 32) ? 1.0f : 1.0f / static_cast<float>(1 << (bits - output_bits));
+    resize.peak = (bits == 32) ? 0 : (1 << output_bits) - 1;
+    resize.dither = dither;
+
+    if (bits == 8)
+        resize.horizontal = resize_horizontal<uint8_t>;
+    else if (bits == 32)
+        resize.horizontal = resize_horizontal<float>;
+    else
+        resize.horizontal = resize_horizontal<uint16_t>;
+
+    if (output_bits == 8)
+        resize.vertical = resize_vertical<uint8_t>;
+    else if (output_bits == 32)
+        resize.vertical = resize_vertical<float>;
+    else
+        resize.vertical = resize_vertical<uint16_t>;
+
+    return resize;
+}
@@ -0,0 +1,471 @@
+#pragma once
+
+// Kernel bodies shared by the vector implementations.
+// Each ISA translation unit includes this after VCL2/vectorclass.h and instantiates the templates with its own vector types:
+// B is the vector of samples used by phase1, V is the vector of lanes used by phase2 and phase3.
+// 8-bit samples are processed in 16-bit lanes, 16-bit samples in 32-bit lanes.
+// One lane holds a pair of adjacent samples, so a single load yields every other sample.
+// Float samples have no wider lanes: V is a float vector, and the even samples of two loads are gathered with a permute.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+// Even elements of a and b: a0 a2 .. b0 b2 ..
+template <typename V>
+static inline V even_elements(const V a, const V b) noexcept
+{
+    if constexpr (V::size() == 4)
+        return blend4<0, 2, 4, 6>(a, b);
+    else if constexpr (V::size() == 8)
+        return blend8<0, 2, 4, 6, 8, 10, 12, 14>(a, b);
+    else
+        return blend16<0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30>(a, b);
+}
+
+// Even elements of a with the low (HIGH = false) or high half of v in the odd elements.
+template <bool HIGH, typename V>
+static inline V odd_from(const V a, const V v) noexcept
+{
+    if constexpr (V::size() == 4)
+        return (HIGH) ? blend4<0, 6, 2, 7>(a, v) : blend4<0, 4, 2, 5>(a, v);
+    else if constexpr (V::size() == 8)
+        return (HIGH) ? blend8<0, 12, 2, 13, 4, 14, 6, 15>(a, v) : blend8<0, 8, 2, 9, 4, 10, 6, 11>(a, v);
+    else
+        return (HIGH) ? blend16<0, 24, 2, 25, 4, 26, 6, 27, 8, 28, 10, 29, 12, 30, 14, 31>(a, v) :
+            blend16<0, 16, 2, 17, 4, 18, 6, 19, 8, 20, 10, 21, 12, 22, 14, 23>(a, v);
+}
+
+// Odd elements of a with the low or high half of v in the even elements.
+template <bool HIGH, typename V>
+static inline V even_from(const V a, const V v) noexcept
+{
+    if constexpr (V::size() == 4)
+        return (HIGH) ? blend4<6, 1, 7, 3>(a, v) : blend4<4, 1, 5, 3>(a, v);
+    else if constexpr (V::size() == 8)
+        return (HIGH) ? blend8<12, 1, 13, 3, 14, 5, 15, 7>(a, v) : blend8<8, 1, 9, 3, 10, 5, 11, 7>(a, v);
+    else
+        return (HIGH) ? blend16<24, 1, 25, 3, 26, 5, 27, 7, 28, 9, 29, 11, 30, 13, 31, 15>(a, v) :
+            blend16<16, 1, 17, 3, 18, 5, 19, 7, 20, 9, 21, 11, 22, 13, 23, 15>(a, v);
+}
+
+// Low or high half of a and b interleaved: a0 b0 a1 b1 ..
+template <bool HIGH, typename V>
+static inline V interleave(const V a, const V b) noexcept
+{
+    if constexpr (V::size() == 4)
+        return (HIGH) ? blend4<2, 6, 3, 7>(a, b) : blend4<0, 4, 1, 5>(a, b);
+    else if constexpr (V::size() == 8)
+        return (HIGH) ? blend8<4, 12, 5, 13, 6, 14, 7, 15>(a, b) : blend8<0, 8, 1, 9, 2, 10, 3, 11>(a, b);
+    else
+        return (HIGH) ? blend16<8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31>(a, b) :
+            blend16<0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23>(a, b);
+}
+
+template <typename T, typename V>
+static inline V load_even(const T* p) noexcept
+{
+    if constexpr (std::is_floating_point_v<T>)
+        return even_elements(V().load(p), V().load(p + V::size()));
+    else
+        return V().load(p) & V(std::numeric_limits<T>::max());
+}
+
+// Writes v to the odd samples of d and the even samples of s to the even ones.
+template <typename T, typename V>
+static inline void store_odd(const T* s, T* d, const V v) noexcept
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        const V s1{ V().load(s + V::size()) };
+        odd_from<false>(V().load(s), v).store(d);
+        odd_from<true>(s1, v).store(d + V::size());
+    }
+    else
+        ((V().load(s) & V(std::numeric_limits<T>::max())) | (v << static_cast<int>(8 * sizeof(T)))).store(d);
+}
+
+// Writes v to the odd samples of p, keeping the even ones.
+template <typename T, typename V>
+static inline void store_odd(T* p, const V v) noexcept
+{
+    store_odd<T, V>(p, p, v);
+}
+
+// Writes v to the even samples of d and the odd samples of s to the odd ones.
+template <typename T, typename V>
+static inline void store_even(const T* s, T* d, const V v) noexcept
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        const V s1{ V().load(s + V::size()) };
+        even_from<false>(V().load(s), v).store(d);
+        even_from<true>(s1, v).store(d + V::size());
+    }
+    else
+        ((V().load(s) & V(~static_cast<int>(std::numeric_limits<T>::max()))) | v).store(d);
+}
+
+// Rounded half of integer lanes, exact half of float lanes.
+template <typename V>
+static inline V halve(const V x) noexcept
+{
+    if constexpr (std::is_floating_point_v<decltype(x[0])>)
+        return x * 0.5f;
+    else
+        return (x + V(1)) >> 1;
+}
+
+// True when every lane of p1 and p2 holds the same value, signed zeros of float lanes included.
+template <typename V>
+static inline bool same_sums(const V p1, const V p2) noexcept
+{
+    if constexpr (std::is_floating_point_v<decltype(p1[0])>)
+        return horizontal_and((p1 == p2) & (sign_bit(p1) == sign_bit(p2)));
+    else
+        return horizontal_and(p1 == p2);
+}
+
+template <bool EDGE, typename V>
+static inline V interpolate(const V a1, const V a2, const V b1, const V b2, const V c1, const V c2, const V tm, const V tm2) noexcept
+{
+    const V p1{ a1 + a2 };
+    const V p2{ b1 + b2 };
+    const V h1{ c1 + p1 - (p2 + p2) - p2 };
+    const V h2{ c2 + p2 - (p1 + p1) - p1 };
+
+    auto use_p1{ abs(h1) < abs(h2) };
+
+    if constexpr (EDGE)
+    {
+        const V v1{ abs(a1 - a2) };
+        const V v2{ abs(b1 - b2) };
+        const auto edge{ (abs(v1 - v2) >= tm) & ~((v1 < tm) & (v2 < tm) & (abs(p1 - p2) < tm2)) };
+
+        use_p1 = (edge & (v1 < v2)) | andnot(use_p1, edge);
+    }
+
+    return halve(select(use_p1, p1, p2));
+}
+
+// Scalar version for the tails, S is the accumulator type.
+template <bool EDGE, typename S>
+static inline S interpolate(const S a1, const S a2, const S b1, const S b2, const S c1, const S c2, const S tm) noexcept
+{
+    const S p1{ a1 + a2 };
+    const S p2{ b1 + b2 };
+    const S h1{ c1 + p1 - 2 * p2 - p2 };
+    const S h2{ c2 + p2 - 2 * p1 - p1 };
+
+    bool use_p1{ std::abs(h1) < std::abs(h2) };
+
+    if constexpr (EDGE)
+    {
+        const S v1{ std::abs(a1 - a2) };
+        const S v2{ std::abs(b1 - b2) };
+        const bool edge{ static_cast<bool>((std::abs(v1 - v2) >= tm) & !((v1 < tm) & (v2 < tm) & (std::abs(p1 - p2) < tm * 2))) };
+
+        use_p1 = (edge & (v1 < v2)) | (!edge & use_p1);
+    }
+
+    if constexpr (std::is_floating_point_v<S>)
+        return (use_p1 ? p1 : p2) * 0.5f;
+    else
+        return ((use_p1 ? p1 : p2) + 1) >> 1;
+}
+
+template <typename T>
+static inline T mean(const T x, const T y) noexcept
+{
+    if constexpr (std::is_floating_point_v<T>)
+        return (x + y) * 0.5f;
+    else
+        return static_cast<T>((x + y + 1) >> 1);
+}
+
+// Source samples on the even positions, the average of the neighbours on the odd ones.
+template <typename T, typename B>
+static inline void upsample_row(const T* srcp, T* __restrict dstp, const int width) noexcept
+{
+    constexpr int step{ B::size() };
+
+    int x{ 0 };
+
+    for (; x + step < width; x += step)
+    {
+        const B s0{ B().load(srcp + x) };
+
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            const B s1{ (s0 + B().load(srcp + x + 1)) * 0.5f };
+            interleave<false>(s0, s1).store(dstp + 2 * x);
+            interleave<true>(s0, s1).store(dstp + 2 * x + step);
+        }
+        else
+        {
+            const B s1{ avg(s0, B().load(srcp + x + 1)) };
+            (extend_low(s0) | (extend_low(s1) << static_cast<int>(8 * sizeof(T)))).store(dstp + 2 * x);
+            (extend_high(s0) | (extend_high(s1) << static_cast<int>(8 * sizeof(T)))).store(dstp + 2 * x + step);
+        }
+    }
+
+    for (; x < width - 1; ++x)
+    {
+        dstp[2 * x] = srcp[x];
+        dstp[2 * x + 1] = mean<T>(srcp[x], srcp[x + 1]);
+    }
+}
+
+// Source samples on the even positions, zero on the odd ones.
+template <typename T, typename B>
+static inline void widen_row(const T* srcp, T* __restrict dstp, const int width) noexcept
+{
+    constexpr int step{ B::size() };
+
+    int x{ 0 };
+
+    for (; x + step < width; x += step)
+    {
+        const B s0{ B().load(srcp + x) };
+
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            interleave<false>(s0, B(0.0f)).store(dstp + 2 * x);
+            interleave<true>(s0, B(0.0f)).store(dstp + 2 * x + step);
+        }
+        else
+        {
+            extend_low(s0).store(dstp + 2 * x);
+            extend_high(s0).store(dstp + 2 * x + step);
+        }
+    }
+
+    for (; x < width - 1; ++x)
+    {
+        dstp[2 * x] = srcp[x];
+        dstp[2 * x + 1] = 0;
+    }
+}
+
+template <typename T, typename B>
+static void bilinear_simd(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept
+{
+    constexpr int step{ B::size() };
+
+    spitch /= sizeof(T);
+    dpitch /= sizeof(T);
+    const T* srcp{ reinterpret_cast<const T*>(srcp_) };
+    T* __restrict dstp{ reinterpret_cast<T*>(dstp_) };
+
+    for (int y{ top }; y < bottom; y += 2)
+    {
+        T* d0{ dstp };
+        T* d1{ dstp + dpitch };
+        const T* s1{ (y / 2 < height - 1) ? srcp + spitch : srcp };
+
+        upsample_row<T, B>(srcp, d0, width);
+        upsample_row<T, B>(s1, d1, width);
+        d0[2 * width - 2] = d0[2 * width - 1] = srcp[width - 1];
+        d1[2 * width - 2] = d1[2 * width - 1] = s1[width - 1];
+
+        // The odd row is the average of the two upscaled rows.
+        int x{ 0 };
+
+        for (; x + step <= 2 * width; x += step)
+        {
+            if constexpr (std::is_floating_point_v<T>)
+                ((B().load(d0 + x) + B().load(d1 + x)) * 0.5f).store(d1 + x);
+            else
+                avg(B().load(d0 + x), B().load(d1 + x)).store(d1 + x);
+        }
+
+        for (; x < 2 * width; ++x)
+            d1[x] = mean<T>(d0[x], d1[x]);
+
+        srcp += spitch;
+        dstp += 2 * dpitch;
+    }
+}
+
+template <typename T, typename B>
+static void phase1_simd(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int top, const int bottom) noexcept
+{
+    spitch /= sizeof(T);
+    dpitch /= sizeof(T);
+    const T* srcp{ reinterpret_cast<const T*>(srcp_) };
+    T* __restrict dstp{ reinterpret_cast<T*>(dstp_) };
+
+    for (int y{ top }; y < bottom; ++y)
+    {
+        dstp[-2] = dstp[-1] = srcp[0];
+
+        if (y == 0 || y == height - 1)
+            upsample_row<T, B>(srcp, dstp, width);
+        else
+            widen_row<T, B>(srcp, dstp, width);
+
+        dstp[2 * width - 2] = dstp[2 * width - 1] = dstp[2 * width] = srcp[width - 1];
+        srcp += spitch;
+        dstp += 2 * dpitch;
+    }
+
+    if (bottom == height)
+    {
+        dstp -= 2 * dpitch + 2;
+        memcpy(dstp + dpitch, dstp, (2 * width + 4) * sizeof(T));
+        dstp += dpitch;
+        memcpy(dstp + dpitch, dstp, (2 * width + 4) * sizeof(T));
+    }
+}
+
+template <typename T, typename V, bool EDGE>
+static void phase2_simd(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept
+{
+    using S = accum_t<T>;
+    constexpr int step{ 2 * V::size() };
+
+    pitch /= sizeof(T);
+
+    const int first{ std::max(top, 1) | 1 };
+    const int p2{ 2 * pitch };
+    T* __restrict dstp{ reinterpret_cast<T*>(ptr) + static_cast<ptrdiff_t>(first - top) * pitch };
+    const T* s0{ dstp - static_cast<ptrdiff_t>(std::min(first, 3)) * pitch };
+    const T* s1{ dstp - pitch };
+    const T* s2{ s1 + p2 };
+    const T* s3{ s2 + p2 };
+
+    const S thr{ threshold<T>(tm) };
+    const V vtm(thr);
+    const V vtm2(thr * 2);
+
+    for (int y{ first }; y < std::min(bottom, height - 1); y += 2)
+    {
+        dstp[-2] = dstp[-1] = dstp[0] = mean<T>(s1[0], s2[0]);
+
+        int x{ 1 };
+
+        // Stores start at x - 1, so they stay on vector boundaries of the row.
+        for (; x + step < width; x += step)
+        {
+            const V a1{ load_even<T, V>(s1 + x - 1) };
+            const V a2{ load_even<T, V>(s2 + x + 1) };
+            const V b1{ load_even<T, V>(s1 + x + 1) };
+            const V b2{ load_even<T, V>(s2 + x - 1) };
+
+            // Both diagonals have the same sum on flat areas and plain gradients, the curvature can only choose between equal candidates there.
+            if (same_sums(a1 + a2, b1 + b2))
+            {
+                store_odd<T, V>(dstp + x - 1, halve(a1 + a2));
+                continue;
+            }
+
+            const V c1{ load_even<T, V>(s0 + x + 1) + load_even<T, V>(s1 + x + 3) + load_even<T, V>(s2 + x - 3) + load_even<T, V>(s3 + x - 1) };
+            const V c2{ load_even<T, V>(s0 + x - 1) + load_even<T, V>(s1 + x - 3) + load_even<T, V>(s2 + x + 3) + load_even<T, V>(s3 + x + 1) };
+
+            store_odd<T, V>(dstp + x - 1, interpolate<EDGE>(a1, a2, b1, b2, c1, c2, vtm, vtm2));
+        }
+
+        for (; x < width - 2; x += 2)
+        {
+            const S c1{ s0[x + 1] + s1[x + 3] + s2[x - 3] + s3[x - 1] };
+            const S c2{ s0[x - 1] + s1[x - 3] + s2[x + 3] + s3[x + 1] };
+
+            dstp[x] = static_cast<T>(interpolate<EDGE, S>(s1[x - 1], s2[x + 1], s1[x + 1], s2[x - 1], c1, c2, thr));
+        }
+
+        dstp[width - 2] = dstp[width - 1] = mean<T>(s1[width - 2], s2[width - 2]);
+
+        s0 = s1;
+        s1 = s2;
+        s2 = s3;
+        s3 += p2;
+        dstp += p2;
+    }
+}
+
+template <typename T, typename V, bool EDGE>
+static void phase3_simd(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept
+{
+    using S = accum_t<T>;
+    constexpr int step{ 2 * V::size() };
+
+    spitch /= sizeof(T);
+    dpitch /= sizeof(T);
+    const T* srcp{ reinterpret_cast<const T*>(srcp_) };
+    T* __restrict dstp{ reinterpret_cast<T*>(dstp_) };
+
+    const S thr{ threshold<T>(tm) };
+    const V vtm(thr);
+    const V vtm2(thr * 2);
+
+    for (int y{ top }; y < bottom; ++y)
+    {
+        if (y == 0 || y >= height - 2)
+            memcpy(dstp, srcp, width * sizeof(T));
+        else
+        {
+            const T* s0{ srcp - static_cast<ptrdiff_t>(std::min(y, 2)) * spitch };
+            const T* s1{ srcp - spitch };
+            const T* s2{ srcp };
+            const T* s3{ s2 + spitch };
+            const T* s4{ s3 + spitch };
+
+            const auto kernel{ [&](const int x) noexcept
+            {
+                const V a1{ load_even<T, V>(s2 + x - 1) };
+                const V a2{ load_even<T, V>(s2 + x + 1) };
+                const V b1{ load_even<T, V>(s1 + x) };
+                const V b2{ load_even<T, V>(s3 + x) };
+
+                // The same shortcut as in phase2.
+                if (same_sums(a1 + a2, b1 + b2))
+                    return halve(a1 + a2);
+
+                const V c1{ load_even<T, V>(s0 + x - 1) + load_even<T, V>(s0 + x + 1) + load_even<T, V>(s4 + x - 1) + load_even<T, V>(s4 + x + 1) };
+                const V c2{ load_even<T, V>(s1 + x - 2) + load_even<T, V>(s1 + x + 2) + load_even<T, V>(s3 + x - 2) + load_even<T, V>(s3 + x + 2) };
+
+                return interpolate<EDGE>(a1, a2, b1, b2, c1, c2, vtm, vtm2);
+            } };
+
+            int x{ 1 + (y & 1) };
+
+            if (y & 1)
+            {
+                // The first pair of the odd rows is not written by this phase.
+                // One unaligned head keeps the remaining stores on vector boundaries; recomputing the overlap is harmless.
+                dstp[0] = s2[0];
+                dstp[1] = s2[1];
+
+                if (x + step < width)
+                {
+                    store_even<T, V>(s2 + x, dstp + x, kernel(x));
+                    x = step;
+                }
+
+                for (; x + step < width; x += step)
+                    store_even<T, V>(s2 + x, dstp + x, kernel(x));
+            }
+            else
+            {
+                for (; x + step < width; x += step)
+                    store_odd<T, V>(s2 + x - 1, dstp + x - 1, kernel(x));
+            }
+
+            // The vector loops stop before x - 1, the rest of the row is copied and interpolated in place.
+            memcpy(dstp + x - 1, s2 + x - 1, (width - x + 1) * sizeof(T));
+
+            for (; x < width - 2; x += 2)
+            {
+                const S c1{ s0[x - 1] + s0[x + 1] + s4[x - 1] + s4[x + 1] };
+                const S c2{ s1[x - 2] + s1[x + 2] + s3[x - 2] + s3[x + 2] };
+
+                dstp[x] = static_cast<T>(interpolate<EDGE, S>(s2[x - 1], s2[x + 1], s1[x], s3[x], c1, c2, thr));
+            }
+        }
+
+        srcp += spitch;
+        dstp += dpitch;
+    }
+}
@@ -0,0 +1,24 @@
+#include "fcbi.h"
+#include "VCL2/vectorclass.h"
+#include "fcbi_simd.h"
+
+// Only the 16-bit kernels: their 32-bit lanes use pabsd and pblendvb instead of the longer SSE2 sequences.
+// The 8-bit kernels gain nothing over SSE2.
+
+template <typename T, bool EDGE>
+void phase2_sse41(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept
+{
+    phase2_simd<T, Vec4i, EDGE>(ptr, width, height, pitch, tm, top, bottom);
+}
+
+template void phase2_sse41<uint16_t, true>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+template void phase2_sse41<uint16_t, false>(uint8_t* __restrict ptr, int width, const int height, int pitch, const int tm, const int top, const int bottom) noexcept;
+
+template <typename T, bool EDGE>
+void phase3_sse41(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept
+{
+    phase3_simd<T, Vec4i, EDGE>(srcp_, dstp_, width, height, spitch, dpitch, tm, top, bottom);
+}
+
+template void phase3_sse41<uint16_t, true>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
+template void phase3_sse41<uint16_t, false>(const uint8_t* srcp_, uint8_t* __restrict dstp_, int width, const int height, int spitch, int dpitch, const int tm, const int top, const int bottom) noexcept;
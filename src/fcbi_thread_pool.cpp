@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <new>
+
+#include "fcbi_thread_pool.h"
+
+thread_pool::thread_pool(const int threads)
+    : stop(false)
+{
+    queue.reserve(threads);
+
+    for (int i{ 1 }; i < threads; ++i)
+        workers.emplace_back(&thread_pool::worker_loop, this);
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+
+    wake.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void thread_pool::work(batch& b) noexcept
+{
+    const int slot{ b.slots++ };
+
+    for (int i{ b.next++ }; i < b.count; i = b.next++)
+        b.invoke(b.task, i, slot);
+}
+
+void thread_pool::worker_loop() noexcept
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        wake.wait(lock, [this] { return stop || !queue.empty(); });
+
+        if (queue.empty())
+            return;
+
+        batch* b{ queue.front() };
+        queue.erase(queue.begin());
+        ++b->active;
+
+        lock.unlock();
+        work(*b);
+        lock.lock();
+
+        if (--b->active == 0)
+            done.notify_all();
+    }
+}
+
+void thread_pool::run(const int count, void (*invoke)(void* task, int i, int slot), void* task)
+{
+    batch b{ invoke, task, count, 0, 0, 0 };
+
+    const int helpers{ std::min(count - 1, static_cast<int>(workers.size())) };
+
+    if (helpers <= 0)
+    {
+        work(b);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.insert(queue.end(), helpers, &b);
+    }
+
+    if (helpers == 1)
+        wake.notify_one();
+    else
+        wake.notify_all();
+
+    work(b);
+
+    // Tickets nobody picked up are dropped, the workers already inside are waited for.
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.erase(std::remove(queue.begin(), queue.end(), &b), queue.end());
+    done.wait(lock, [&b] { return b.active == 0; });
+}
+
+// Every buffer starts on its own cache line, so that windows of different threads do not share one.
+constexpr std::align_val_t cache_line{ 64 };
+
+scratch_pool::scratch_pool(const size_t size)
+    : size(size)
+{
+}
+
+scratch_pool::~scratch_pool()
+{
+    for (uint8_t* buffer : buffers)
+        operator delete[](buffer, cache_line);
+}
+
+uint8_t* scratch_pool::acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (idle.empty())
+    {
+        buffers.reserve(buffers.size() + 1);
+        idle.reserve(buffers.size() + 1);
+        uint8_t* buffer{ static_cast<uint8_t*>(operator new[](size, cache_line)) };
+        buffers.emplace_back(buffer);
+
+        return buffer;
+    }
+
+    uint8_t* buffer{ idle.back() };
+    idle.pop_back();
+
+    return buffer;
+}
+
+void scratch_pool::release(uint8_t* buffer) noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // Capacity for every buffer is reserved in acquire().
+    idle.emplace_back(buffer);
+}
+
+int resolve_threads(const int threads) noexcept
+{
+    if (threads > 0)
+        return threads;
+
+    return std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+}
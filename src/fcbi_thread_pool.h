@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads shared by all frames of a filter instance.
+// run() may be called from several host threads at once.
+class thread_pool
+{
+    struct batch
+    {
+        void (*invoke)(void* task, int i, int slot);
+        void* task;
+        int count;
+        std::atomic<int> next;
+        std::atomic<int> slots;
+        // Workers inside the batch, guarded by the pool mutex.
+        int active;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<batch*> queue;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stop;
+
+    static void work(batch& b) noexcept;
+    void worker_loop() noexcept;
+    void run(const int count, void (*invoke)(void* task, int i, int slot), void* task);
+
+public:
+    // threads is the total number of threads working on a batch, including the caller of run().
+    explicit thread_pool(const int threads);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Calls task(i, slot) for every i in [0, count) and returns when all of them are done.
+    // slot is in [0, threads) and unique among the threads working on this batch at the same time.
+    template <typename F>
+    void run(const int count, F&& task)
+    {
+        run(count, [](void* t, int i, int slot) { (*static_cast<std::remove_reference_t<F>*>(t))(i, slot); }, const_cast<void*>(static_cast<const void*>(&task)));
+    }
+};
+
+// Reusable scratch buffers of one size, aligned to cache lines.
+// Buffers are only allocated when all existing ones are in use, so the steady state does not allocate.
+class scratch_pool
+{
+    size_t size;
+    std::vector<uint8_t*> buffers;
+    std::vector<uint8_t*> idle;
+    std::mutex mutex;
+
+public:
+    explicit scratch_pool(const size_t size);
+    ~scratch_pool();
+
+    scratch_pool(const scratch_pool&) = delete;
+    scratch_pool& operator=(const scratch_pool&) = delete;
+
+    uint8_t* acquire();
+    void release(uint8_t* buffer) noexcept;
+};
+
+// Resolves the `threads` argument: 0 uses every logical core.
+int resolve_threads(const int threads) noexcept;
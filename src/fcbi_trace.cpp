@@ -0,0 +1,114 @@
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include "fcbi_trace.h"
+
+// Spans a thread records past this are dropped, so that a long run does not exhaust the memory (about 40 MB per thread).
+constexpr size_t max_events{ 1 << 20 };
+
+static std::atomic<uint64_t> instances{ 0 };
+
+trace_recorder::trace_recorder(std::string path)
+    : id(instances++), path(std::move(path)), origin(clock::now())
+{}
+
+std::unique_ptr<trace_recorder> trace_recorder::from_environment()
+{
+    const char* path{ std::getenv("FCBI_TRACE") };
+
+    if (!path || !*path)
+        return nullptr;
+
+    auto trace{ std::make_unique<trace_recorder>(path) };
+
+    if (trace->id)
+    {
+        const size_t name{ trace->path.find_last_of("/\\") + 1 };
+        const size_t extension{ trace->path.find_last_of('.') };
+        trace->path.insert((extension != std::string::npos && extension > name) ? extension : trace->path.size(), "." + std::to_string(trace->id));
+    }
+
+    return trace;
+}
+
+trace_recorder::thread_buffer* trace_recorder::local() noexcept
+{
+    // The buffers of every recorder the thread recorded for, by id, since the addresses of freed recorders are reused.
+    // Entries of freed recorders are never matched again, tracing is for short diagnostic runs.
+    static thread_local std::vector<std::pair<uint64_t, thread_buffer*>> cache;
+
+    for (const auto& [recorder, buffer] : cache)
+    {
+        if (recorder == id)
+            return buffer;
+    }
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(std::make_unique<thread_buffer>(thread_buffer{ static_cast<int>(buffers.size()), {} }));
+        thread_buffer* buffer{ buffers.back().get() };
+        buffer->events.reserve(4096);
+        cache.emplace_back(id, buffer);
+
+        return buffer;
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void trace_recorder::span(const char* name, const clock::time_point start, const clock::time_point end, const int64_t frame, const int plane) noexcept
+{
+    thread_buffer* buffer{ local() };
+
+    if (!buffer || buffer->events.size() == max_events)
+        return;
+
+    try
+    {
+        buffer->events.push_back({ name, std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count(),
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), frame, plane });
+    }
+    catch (...)
+    {}
+}
+
+bool trace_recorder::write() const
+{
+    FILE* file{ std::fopen(path.c_str(), "wb") };
+
+    if (!file)
+        return false;
+
+    // Each instance is a process of the timeline, each thread that recorded spans one of its threads. Times are in microseconds.
+    const uint64_t pid{ id + 1 };
+    std::fprintf(file, "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%" PRIu64 ",\"tid\":0,\"args\":{\"name\":\"FCBI %" PRIu64 "\"}}",
+        pid, id);
+
+    for (const auto& buffer : buffers)
+    {
+        std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%" PRIu64 ",\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", pid, buffer->tid,
+            buffer->tid);
+
+        for (const event& e : buffer->events)
+        {
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"fcbi\",\"ph\":\"X\",\"ts\":%" PRId64 ".%03d,\"dur\":%" PRId64 ".%03d,\"pid\":%" PRIu64
+                ",\"tid\":%d,\"args\":{\"frame\":%" PRId64, e.name, e.start / 1000, static_cast<int>(e.start % 1000), e.duration / 1000,
+                static_cast<int>(e.duration % 1000), pid, buffer->tid, e.frame);
+
+            if (e.plane >= 0)
+                std::fprintf(file, ",\"plane\":%d", e.plane);
+
+            std::fputs("}}", file);
+        }
+    }
+
+    std::fputs("\n]}\n", file);
+
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline of a filter instance in the Chrome trace format, for chrome://tracing and ui.perfetto.dev.
+// Every thread appends its spans to its own buffer without locking, the file is written once no thread records anymore.
+class trace_recorder
+{
+    struct event
+    {
+        const char* name;
+        int64_t start;
+        int64_t duration;
+        int64_t frame;
+        int plane;
+    };
+
+    struct thread_buffer
+    {
+        int tid;
+        std::vector<event> events;
+    };
+
+    uint64_t id;
+    std::string path;
+    std::chrono::steady_clock::time_point origin;
+    // Only locked when a thread records its first span for this recorder.
+    std::mutex mutex;
+    std::vector<std::unique_ptr<thread_buffer>> buffers;
+
+    thread_buffer* local() noexcept;
+
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit trace_recorder(std::string path);
+
+    trace_recorder(const trace_recorder&) = delete;
+    trace_recorder& operator=(const trace_recorder&) = delete;
+
+    // A recorder writing to the path in FCBI_TRACE, or null when it is not set.
+    // Instances after the first one of the process write to the path with their number before the extension.
+    static std::unique_ptr<trace_recorder> from_environment();
+
+    // Span [start, end) on the calling thread. name must outlive the recorder, plane -1 is a span of the whole frame.
+    void span(const char* name, const clock::time_point start, const clock::time_point end, const int64_t frame, const int plane) noexcept;
+
+    // Writes every span recorded so far. Returns false when the file can not be written.
+    bool write() const;
+};
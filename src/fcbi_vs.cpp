@@ -1,10 +1,9 @@
 #include <memory>
 #include <string>
 
-#include "fcbi.h"
+#include "fcbi_core.h"
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
-#include "VCL2/instrset.h"
 
 
 using namespace std::literals;
@@ -14,12 +13,8 @@ struct FCBIData
     VSNode* node;
     VSVideoInfo vi;
 
-    int tm;
-    VSVideoInfo vit;
-
-    void (*process_phase1)(const uint8_t* srcp, uint8_t* __restrict dstp, const int width, const int height, const int spitch, const int dpitch) noexcept;
-    void (*process_phase2)(uint8_t* __restrict ptr, const int width, const int height, const int pitch, const int tm) noexcept;
-    void (*process_phase3)(uint8_t* __restrict ptr, const int width, const int height, const int pitch, const int tm) noexcept;
+    fcbi_context* core;
+    bool stats;
 };
 
 static const VSFrame* VS_CC FCBIGetFrame(int n, int activationReason, void* instanceData, [[maybe_unused]] void** frameData, VSFrameContext* frameCtx, VSCore* core, const VSAPI* vsapi)
@@ -31,26 +26,44 @@ static const VSFrame* VS_CC FCBIGetFrame(int n, int activationReason, void* inst
     else if (activationReason == arAllFramesReady)
     {
         const VSFrame* src{ vsapi->getFrameFilter(n, d->node, frameCtx) };
-        VSFrame* tmp{ vsapi->newVideoFrame(&d->vit.format, d->vit.width, d->vit.height, src, core) };
         VSFrame* dst{ vsapi->newVideoFrame(&d->vi.format, d->vi.width, d->vi.height, src, core) };
 
-        const ptrdiff_t tpitch{ vsapi->getStride(tmp, 0) };
-        uint8_t* __restrict tmpp{ vsapi->getWritePtr(tmp, 0) + tpitch };
+        const uint8_t* srcp[3];
+        ptrdiff_t spitch[3];
+        uint8_t* dstp[3];
+        ptrdiff_t dpitch[3];
 
         for (int p{ 0 }; p < d->vi.format.numPlanes; ++p)
         {
-            const int width{ vsapi->getFrameWidth(dst, p) };
-            const int height{ vsapi->getFrameHeight(dst, p) };
+            srcp[p] = vsapi->getReadPtr(src, p);
+            spitch[p] = vsapi->getStride(src, p);
+            dstp[p] = vsapi->getWritePtr(dst, p);
+            dpitch[p] = vsapi->getStride(dst, p);
+        }
 
-            d->process_phase1(vsapi->getReadPtr(src, p), tmpp, vsapi->getFrameWidth(src, p), vsapi->getFrameHeight(src, p), vsapi->getStride(src, p), tpitch);
-            d->process_phase2(tmpp, width, height, tpitch, d->tm);
-            d->process_phase3(tmpp, width, height, tpitch, d->tm);
+        const int err{ fcbi_process_frame(d->core, srcp, spitch, dstp, dpitch) };
+
+        vsapi->freeFrame(src);
 
-            vsh::bitblt(reinterpret_cast<uint8_t*>(vsapi->getWritePtr(dst, p)), vsapi->getStride(dst, p), reinterpret_cast<uint8_t*>(tmpp), tpitch, width * d->vi.format.bytesPerSample, height);
+        if (err)
+        {
+            vsapi->setFilterError(("FCBI: "s + fcbi_last_error()).c_str(), frameCtx);
+            vsapi->freeFrame(dst);
+            return nullptr;
         }
 
-        vsapi->freeFrame(src);
-        vsapi->freeFrame(tmp);
+        if (d->stats)
+        {
+            fcbi_stats s;
+            fcbi_last_stats(&s);
+
+            VSMap* props{ vsapi->getFramePropertiesRW(dst) };
+            vsapi->mapSetInt(props, "_FCBIPhase1Us", s.phase1_us, maReplace);
+            vsapi->mapSetInt(props, "_FCBIPhase2Us", s.phase2_us, maReplace);
+            vsapi->mapSetInt(props, "_FCBIPhase3Us", s.phase3_us, maReplace);
+            vsapi->mapSetInt(props, "_FCBIOutputUs", s.output_us, maReplace);
+            vsapi->mapSetInt(props, "_FCBITotalUs", s.total_us, maReplace);
+        }
 
         return dst;
     }
@@ -61,6 +74,7 @@ static const VSFrame* VS_CC FCBIGetFrame(int n, int activationReason, void* inst
 static void VS_CC FCBIFree(void* instanceData, [[maybe_unused]] VSCore* core, const VSAPI* vsapi) {
     FCBIData* d{ static_cast<FCBIData*>(instanceData) };
     vsapi->freeNode(d->node);
+    fcbi_free(d->core);
     delete d;
 }
 
@@ -74,77 +88,100 @@ static void VS_CC FCBICreate(const VSMap* in, VSMap* out, [[maybe_unused]] void*
         d->vi = *vsapi->getVideoInfo(d->node);
         int err{ 0 };
 
-        if (d->vi.format.colorFamily == cfRGB || d->vi.format.sampleType == stFloat || d->vi.format.bytesPerSample == 4)
-            throw "clip must be in YUV 8..16-bit planar format."s;
+        if (d->vi.format.colorFamily == cfRGB || (d->vi.format.sampleType == stFloat && d->vi.format.bytesPerSample != 4))
+            throw "clip must be in YUV 8..16-bit or 32-bit float planar format."s;
         if (d->vi.format.subSamplingW > 1)
             throw "input clip is unsupported format."s;
         if (d->vi.width < 16 || d->vi.height < 16)
             throw "input clip is too small."s;
 
-        const int peak{ (1 << d->vi.format.bitsPerSample) - 1 };
+        fcbi_params params;
+        fcbi_default_params(&params);
+        params.width = d->vi.width;
+        params.height = d->vi.height;
+        params.bits = d->vi.format.bitsPerSample;
+        params.num_planes = d->vi.format.numPlanes;
+        params.subsampling_w = d->vi.format.subSamplingW;
+        params.subsampling_h = d->vi.format.subSamplingH;
+        params.edge = !!vsapi->mapGetIntSaturated(in, "ed", 0, &err);
+
+        params.tm = vsapi->mapGetIntSaturated(in, "tm", 0, &err);
+        if (err)
+            params.tm = -1;
 
-        d->tm = vsapi->mapGetIntSaturated(in, "tm", 0, &err);
+        params.opt = vsapi->mapGetIntSaturated(in, "opt", 0, &err);
         if (err)
-            d->tm = (d->vi.format.bytesPerSample == 1) ? 30 : (30 * peak / 255);
-        if (d->tm < 0 || d->tm > peak)
-            throw "tm is out of range."s;
+            params.opt = -1;
 
-        int64_t opt{ vsapi->mapGetInt(in, "opt", 0, &err) };
+        params.threads = vsapi->mapGetIntSaturated(in, "threads", 0, &err);
         if (err)
-            opt = -1;
-        if (opt < -1 || opt > 1)
-            throw "opt must be between -1..1."s;
+            params.threads = 1;
 
-        const int iset{ instrset_detect() };
-        if (opt == 1 && iset < 2)
-            throw "opt = 1 requires SSE2."s;
+        params.factor = vsapi->mapGetIntSaturated(in, "factor", 0, &err);
+        if (err)
+            params.factor = 2;
 
-        d->vi.width *= 2;
-        d->vi.height *= 2;
+        params.target_width = vsapi->mapGetIntSaturated(in, "width", 0, &err);
+        if (err)
+            params.target_width = 0;
 
-        d->vit = d->vi;
-        d->vit.format.colorFamily = cfGray;
+        params.target_height = vsapi->mapGetIntSaturated(in, "height", 0, &err);
+        if (err)
+            params.target_height = 0;
 
-        const bool _e{ !!vsapi->mapGetIntSaturated(in, "ed", 0, &err) };
+        params.center = !!vsapi->mapGetIntSaturated(in, "center", 0, &err);
 
-        if (d->vi.format.bytesPerSample == 1)
+        params.chroma_location = vsapi->mapGetIntSaturated(in, "chroma_loc", 0, &err);
+        if (err)
+            params.chroma_location = 0;
+
+        params.output_bits = vsapi->mapGetIntSaturated(in, "output_bits", 0, &err);
+        if (err)
+            params.output_bits = 0;
+
+        params.dither = !!vsapi->mapGetIntSaturated(in, "dither", 0, &err);
+
+        params.chroma = vsapi->mapGetIntSaturated(in, "chroma", 0, &err);
+
+        params.crop_left = vsapi->mapGetIntSaturated(in, "crop_left", 0, &err);
+        params.crop_top = vsapi->mapGetIntSaturated(in, "crop_top", 0, &err);
+        params.crop_right = vsapi->mapGetIntSaturated(in, "crop_right", 0, &err);
+        params.crop_bottom = vsapi->mapGetIntSaturated(in, "crop_bottom", 0, &err);
+
+        params.reuse = !!vsapi->mapGetIntSaturated(in, "reuse", 0, &err);
+
+        params.stats = !!vsapi->mapGetIntSaturated(in, "stats", 0, &err);
+        d->stats = params.stats;
+
+        d->core = fcbi_create(&params);
+        if (!d->core)
+            throw std::string{ fcbi_last_error() };
+
+        d->vi.width = fcbi_output_width(d->core, 0);
+        d->vi.height = fcbi_output_height(d->core, 0);
+
+        // Chroma kept at the source size is subsampled by factor more.
+        const int shift{ (params.chroma == 2 && params.num_planes == 3) ? ((params.factor == 8) ? 3 : (params.factor == 4) ? 2 : 1) : 0 };
+
+        if (params.output_bits && params.output_bits != d->vi.format.bitsPerSample)
         {
-            d->process_phase1 = ((opt == -1 && iset >= 2) || opt == 1) ? phase1_sse2<uint8_t> : phase1_c<uint8_t>;
-
-            if (_e)
-            {
-                d->process_phase2 = phase2_c<uint8_t, true>;
-                d->process_phase3 = phase3_c<uint8_t, true>;
-            }
-            else
-            {
-                d->process_phase2 = phase2_c<uint8_t, false>;
-                d->process_phase3 = phase3_c<uint8_t, false>;
-            }
+            if (!vsapi->queryVideoFormat(&d->vi.format, d->vi.format.colorFamily, d->vi.format.sampleType, params.output_bits,
+                d->vi.format.subSamplingW, d->vi.format.subSamplingH, core))
+                throw "output_bits gives an unsupported format."s;
         }
-        else
+
+        if (shift)
         {
-            d->process_phase1 = ((opt == -1 && iset >= 2) || opt == 1) ? phase1_sse2<uint16_t> : phase1_c<uint16_t>;
-
-            if (_e)
-            {
-                d->process_phase2 = phase2_c<uint16_t, true>;
-                d->process_phase3 = phase3_c<uint16_t, true>;
-            }
-            else
-            {
-                d->process_phase2 = phase2_c<uint16_t, false>;
-                d->process_phase3 = phase3_c<uint16_t, false>;
-            }
+            if (!vsapi->queryVideoFormat(&d->vi.format, d->vi.format.colorFamily, d->vi.format.sampleType, d->vi.format.bitsPerSample,
+                d->vi.format.subSamplingW + shift, d->vi.format.subSamplingH + shift, core))
+                throw "chroma=2 gives an unsupported subsampling."s;
         }
-
-        d->vit.width = (d->vit.width + 4 + 31) & ~31;
-        d->vit.height += 2;
     }
     catch (const std::string& error)
     {
-        vsapi->mapSetError(out, ("grayworld: " + error).c_str());
+        vsapi->mapSetError(out, ("FCBI: " + error).c_str());
         vsapi->freeNode(d->node);
+        fcbi_free(d->core);
         return;
     }
 
@@ -160,7 +197,22 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin* plugin, const VSPLUGINAPI
         "clip:vnode;"
         "ed:int:opt;"
         "tm:int:opt;"
-        "opt:int:opt;",
+        "opt:int:opt;"
+        "threads:int:opt;"
+        "factor:int:opt;"
+        "width:int:opt;"
+        "height:int:opt;"
+        "center:int:opt;"
+        "chroma_loc:int:opt;"
+        "output_bits:int:opt;"
+        "dither:int:opt;"
+        "chroma:int:opt;"
+        "crop_left:int:opt;"
+        "crop_top:int:opt;"
+        "crop_right:int:opt;"
+        "crop_bottom:int:opt;"
+        "reuse:int:opt;"
+        "stats:int:opt;",
         "clip:vnode;",
         FCBICreate, nullptr, plugin);
 }
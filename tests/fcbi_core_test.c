@@ -0,0 +1,689 @@
+/*
+ * Test of the C API of libfcbi_core.
+ * Invalid parameters have to be rejected with a message, and a context with the best opt level and several threads
+ * has to give the same frames as a single threaded context running the C code, through fcbi_process_frame and fcbi_process_plane.
+ * Some frames run opt 1, which auto-detection picks on CPUs without AVX2.
+ * A cropped output has to be the same rectangle of the whole output, and reuse has to give the same frames as upscaling them whole.
+ * Frames at the peak have to stay at the peak when converted to a lower depth. Stats are only reported when asked for, and FCBI_TRACE writes a trace of the frames when the context is freed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fcbi_core.h"
+
+#ifdef _WIN32
+#define putenv _putenv
+#endif
+
+static int failures = 0;
+
+static void expect_invalid(const fcbi_params* params, const char* what)
+{
+    fcbi_context* context = fcbi_create(params);
+
+    if (context || !fcbi_last_error()[0])
+    {
+        ++failures;
+        printf("FAIL %s was accepted\n", what);
+    }
+
+    fcbi_free(context);
+}
+
+static void test_params(void)
+{
+    fcbi_params base;
+    fcbi_params p;
+
+    fcbi_default_params(&base);
+    base.width = 64;
+    base.height = 32;
+    base.bits = 8;
+    base.num_planes = 3;
+    base.subsampling_w = 1;
+    base.subsampling_h = 1;
+
+    p = base; p.width = 15; expect_invalid(&p, "width 15");
+    p = base; p.bits = 17; expect_invalid(&p, "bits 17");
+    p = base; p.num_planes = 2; expect_invalid(&p, "num_planes 2");
+    p = base; p.subsampling_w = 2; expect_invalid(&p, "subsampling_w 2");
+    p = base; p.factor = 3; expect_invalid(&p, "factor 3");
+    p = base; p.target_width = 129; expect_invalid(&p, "target_width 129");
+    p = base; p.target_height = 33; expect_invalid(&p, "target_height 33 with 4:2:0");
+    p = base; p.output_bits = 17; expect_invalid(&p, "output_bits 17");
+    p = base; p.chroma_location = 6; expect_invalid(&p, "chroma_location 6");
+    p = base; p.chroma = 3; expect_invalid(&p, "chroma 3");
+    p = base; p.chroma = 2; p.target_width = 96; expect_invalid(&p, "chroma 2 with target_width");
+    p = base; p.crop_left = 64; p.crop_right = 64; expect_invalid(&p, "crop of the whole width");
+    p = base; p.crop_top = 3; expect_invalid(&p, "crop_top 3 with 4:2:0");
+    p = base; p.chroma = 2; p.crop_left = 2; expect_invalid(&p, "crop_left 2 with chroma 2");
+    p = base; p.crop_bottom = -2; expect_invalid(&p, "crop_bottom -2");
+    p = base; p.tm = 256; expect_invalid(&p, "tm 256");
+    p = base; p.opt = 4; expect_invalid(&p, "opt 4");
+    p = base; p.threads = -1; expect_invalid(&p, "threads -1");
+
+    if (fcbi_max_opt() < 3)
+    {
+        p = base;
+        p.opt = fcbi_max_opt() + 1;
+        expect_invalid(&p, "unsupported opt");
+    }
+}
+
+static fcbi_params format(const int width, const int height, const int bits, const int num_planes, const int ssw, const int ssh)
+{
+    fcbi_params params;
+
+    fcbi_default_params(&params);
+    params.width = width;
+    params.height = height;
+    params.bits = bits;
+    params.num_planes = num_planes;
+    params.subsampling_w = ssw;
+    params.subsampling_h = ssh;
+    params.chroma_location = 2;
+
+    return params;
+}
+
+/* params holds the format, the filter parameters and the opt level compared with the C code, threads are set here. */
+static void test_frame(fcbi_params params)
+{
+    const int width = params.width;
+    const int height = params.height;
+    const int bits = params.bits;
+    const int num_planes = params.num_planes;
+    const int ssw = params.subsampling_w;
+    const int ssh = params.subsampling_h;
+    const int edge = params.edge;
+    const int factor = params.factor;
+    const int output_bits = (params.output_bits) ? params.output_bits : bits;
+    const int size = (bits == 8) ? 1 : (bits == 32) ? 4 : 2;
+    const int out_size = (output_bits == 8) ? 1 : (output_bits == 32) ? 4 : 2;
+    fcbi_context* ref;
+    fcbi_context* context;
+    const uint8_t* srcp[3];
+    uint8_t* dstp[3];
+    uint8_t* refp[3];
+    ptrdiff_t spitch[3];
+    ptrdiff_t dpitch[3];
+    int i;
+    int p;
+
+    const int opt = params.opt;
+    params.opt = 0;
+    ref = fcbi_create(&params);
+    params.opt = opt;
+    params.threads = 3;
+    context = fcbi_create(&params);
+
+    if (!ref || !context)
+    {
+        ++failures;
+        printf("FAIL fcbi_create: %s\n", fcbi_last_error());
+        fcbi_free(ref);
+        fcbi_free(context);
+        return;
+    }
+
+    for (p = 0; p < num_planes; ++p)
+    {
+        const int w = (p) ? width >> ssw : width;
+        const int h = (p) ? height >> ssh : height;
+        const int copied = p && params.chroma == 2;
+        const int div_w = (p) ? ((copied) ? factor << ssw : 1 << ssw) : 1;
+        const int div_h = (p) ? ((copied) ? factor << ssh : 1 << ssh) : 1;
+        const int ow = ((copied) ? w : (params.target_width) ? params.target_width / div_w : factor * w) - (params.crop_left + params.crop_right) / div_w;
+        const int oh = ((copied) ? h : (params.target_height) ? params.target_height / div_h : factor * h) - (params.crop_top + params.crop_bottom) / div_h;
+        uint8_t* src;
+
+        if (fcbi_output_width(context, p) != ow || fcbi_output_height(context, p) != oh)
+        {
+            ++failures;
+            printf("FAIL output size of plane %d\n", p);
+        }
+
+        /* Strides larger than the rows, the samples past the rows must not matter. The planes start 32 bytes into the allocation,
+           so that the last row ends it and reads past the rows are caught by the address sanitizer. */
+        spitch[p] = (ptrdiff_t)w * size + 32;
+        dpitch[p] = (ptrdiff_t)fcbi_output_width(context, p) * out_size + 64;
+        src = (uint8_t*)malloc(spitch[p] * h);
+        dstp[p] = (uint8_t*)calloc(dpitch[p] * oh, 1);
+        refp[p] = (uint8_t*)calloc(dpitch[p] * oh, 1);
+
+        for (i = 0; i < spitch[p] * h; ++i)
+            src[i] = (uint8_t)rand();
+        if (size == 2)
+            for (i = 0; i < spitch[p] * h / 2; ++i)
+                ((uint16_t*)src)[i] &= (1 << bits) - 1;
+        if (size == 4)
+            for (i = 0; i < spitch[p] * h / 4; ++i)
+                ((float*)src)[i] = (float)rand() / RAND_MAX;
+
+        srcp[p] = src + 32;
+    }
+
+    if (fcbi_process_frame(ref, srcp, spitch, refp, dpitch) || fcbi_process_frame(context, srcp, spitch, dstp, dpitch))
+    {
+        ++failures;
+        printf("FAIL fcbi_process_frame: %s\n", fcbi_last_error());
+    }
+
+    for (p = 0; p < num_planes; ++p)
+    {
+        const size_t bytes = (size_t)dpitch[p] * fcbi_output_height(context, p);
+
+        if (memcmp(refp[p], dstp[p], bytes))
+        {
+            ++failures;
+            printf("FAIL fcbi_process_frame: width=%d height=%d bits=%d ed=%d factor=%d output_bits=%d chroma=%d plane %d\n", width, height, bits, edge, factor, output_bits, params.chroma, p);
+        }
+
+        memset(dstp[p], 0, bytes);
+
+        if (fcbi_process_plane(context, p, srcp[p], spitch[p], dstp[p], dpitch[p]) || memcmp(refp[p], dstp[p], bytes))
+        {
+            ++failures;
+            printf("FAIL fcbi_process_plane: width=%d height=%d bits=%d ed=%d factor=%d output_bits=%d chroma=%d plane %d\n", width, height, bits, edge, factor, output_bits, params.chroma, p);
+        }
+    }
+
+    if (!fcbi_process_plane(context, num_planes, srcp[0], spitch[0], dstp[0], dpitch[0]))
+    {
+        ++failures;
+        printf("FAIL fcbi_process_plane accepted plane %d\n", num_planes);
+    }
+
+    for (p = 0; p < num_planes; ++p)
+    {
+        free((void*)(srcp[p] - 32));
+        free(dstp[p]);
+        free(refp[p]);
+    }
+
+    fcbi_free(ref);
+    fcbi_free(context);
+}
+
+/* Upscales a random frame with and without the crop of params and compares the rectangle. */
+static void test_crop(fcbi_params params)
+{
+    const int size = (params.bits == 8) ? 1 : (params.bits == 32) ? 4 : 2;
+    const int output_bits = (params.output_bits) ? params.output_bits : params.bits;
+    const int out_size = (output_bits == 8) ? 1 : (output_bits == 32) ? 4 : 2;
+    fcbi_params whole = params;
+    fcbi_context* full;
+    fcbi_context* context;
+    const uint8_t* srcp[3];
+    uint8_t* dstp[3];
+    uint8_t* refp[3];
+    ptrdiff_t spitch[3];
+    ptrdiff_t dpitch[3];
+    ptrdiff_t rpitch[3];
+    int i;
+    int p;
+
+    whole.crop_left = whole.crop_top = whole.crop_right = whole.crop_bottom = 0;
+    params.threads = 2;
+    full = fcbi_create(&whole);
+    context = fcbi_create(&params);
+
+    if (!full || !context)
+    {
+        ++failures;
+        printf("FAIL fcbi_create: %s\n", fcbi_last_error());
+        fcbi_free(full);
+        fcbi_free(context);
+        return;
+    }
+
+    for (p = 0; p < params.num_planes; ++p)
+    {
+        const int w = (p) ? params.width >> params.subsampling_w : params.width;
+        const int h = (p) ? params.height >> params.subsampling_h : params.height;
+        uint8_t* src;
+
+        spitch[p] = (ptrdiff_t)w * size;
+        rpitch[p] = (ptrdiff_t)fcbi_output_width(full, p) * out_size;
+        dpitch[p] = (ptrdiff_t)fcbi_output_width(context, p) * out_size;
+        src = (uint8_t*)malloc(spitch[p] * h);
+        refp[p] = (uint8_t*)malloc(rpitch[p] * fcbi_output_height(full, p));
+        dstp[p] = (uint8_t*)malloc(dpitch[p] * fcbi_output_height(context, p));
+
+        for (i = 0; i < spitch[p] * h; ++i)
+            src[i] = (uint8_t)rand();
+        if (size == 2)
+            for (i = 0; i < spitch[p] * h / 2; ++i)
+                ((uint16_t*)src)[i] &= (1 << params.bits) - 1;
+        if (size == 4)
+            for (i = 0; i < spitch[p] * h / 4; ++i)
+                ((float*)src)[i] = (float)rand() / RAND_MAX;
+
+        srcp[p] = src;
+    }
+
+    if (fcbi_process_frame(full, srcp, spitch, refp, rpitch) || fcbi_process_frame(context, srcp, spitch, dstp, dpitch))
+    {
+        ++failures;
+        printf("FAIL fcbi_process_frame: %s\n", fcbi_last_error());
+    }
+
+    for (p = 0; p < params.num_planes; ++p)
+    {
+        /* Chroma kept at the source size is subsampled by factor more. */
+        const int div_w = (p) ? ((params.chroma == 2) ? params.factor : 1) << params.subsampling_w : 1;
+        const int div_h = (p) ? ((params.chroma == 2) ? params.factor : 1) << params.subsampling_h : 1;
+        const int x = params.crop_left / div_w;
+        const int y = params.crop_top / div_h;
+
+        for (i = 0; i < fcbi_output_height(context, p); ++i)
+        {
+            if (memcmp(refp[p] + (y + i) * rpitch[p] + x * out_size, dstp[p] + i * dpitch[p], dpitch[p]))
+            {
+                ++failures;
+                printf("FAIL crop: width=%d height=%d bits=%d factor=%d crop=%d,%d,%d,%d plane %d row %d\n", params.width, params.height, params.bits,
+                    params.factor, params.crop_left, params.crop_top, params.crop_right, params.crop_bottom, p, i);
+                break;
+            }
+        }
+    }
+
+    for (p = 0; p < params.num_planes; ++p)
+    {
+        free((void*)srcp[p]);
+        free(dstp[p]);
+        free(refp[p]);
+    }
+
+    fcbi_free(full);
+    fcbi_free(context);
+}
+
+/* Upscales a sequence of frames that change in a few rows with reuse, and compares every frame with the one upscaled without it. */
+static void test_reuse(fcbi_params params)
+{
+    const int size = (params.bits == 8) ? 1 : (params.bits == 32) ? 4 : 2;
+    const int output_bits = (params.output_bits) ? params.output_bits : params.bits;
+    const int out_size = (output_bits == 8) ? 1 : (output_bits == 32) ? 4 : 2;
+    fcbi_params plain = params;
+    fcbi_context* fresh;
+    fcbi_context* context;
+    uint8_t* src[3];
+    const uint8_t* srcp[3];
+    uint8_t* dstp[3];
+    uint8_t* refp[3];
+    ptrdiff_t spitch[3];
+    ptrdiff_t dpitch[3];
+    int frame;
+    int i;
+    int p;
+
+    plain.reuse = 0;
+    params.reuse = 1;
+    params.threads = 2;
+    fresh = fcbi_create(&plain);
+    context = fcbi_create(&params);
+
+    if (!fresh || !context)
+    {
+        ++failures;
+        printf("FAIL fcbi_create: %s\n", fcbi_last_error());
+        fcbi_free(fresh);
+        fcbi_free(context);
+        return;
+    }
+
+    for (p = 0; p < params.num_planes; ++p)
+    {
+        const int h = (p) ? params.height >> params.subsampling_h : params.height;
+
+        spitch[p] = (ptrdiff_t)((p) ? params.width >> params.subsampling_w : params.width) * size;
+        /* Padded rows, which the history does not store. */
+        dpitch[p] = (ptrdiff_t)fcbi_output_width(context, p) * out_size + 64;
+        src[p] = (uint8_t*)malloc(spitch[p] * h);
+        refp[p] = (uint8_t*)malloc(dpitch[p] * fcbi_output_height(context, p));
+        dstp[p] = (uint8_t*)malloc(dpitch[p] * fcbi_output_height(context, p));
+        srcp[p] = src[p];
+    }
+
+    /* The first frame is new, the second one the same, the others change rows at the top, in the middle and at the bottom. */
+    for (frame = 0; frame < 6; ++frame)
+    {
+        for (p = 0; p < params.num_planes; ++p)
+        {
+            const int h = (p) ? params.height >> params.subsampling_h : params.height;
+            const int first = (frame == 0) ? 0 : (frame == 2) ? 0 : (frame == 3) ? h / 2 : (frame == 4) ? h - 1 : h;
+            const int last = (frame == 0) ? h : (frame == 2) ? 1 : (frame == 3) ? h / 2 + 3 : h;
+
+            for (i = (int)(first * spitch[p]); i < last * spitch[p]; ++i)
+                src[p][i] = (uint8_t)rand();
+            if (size == 2)
+                for (i = (int)(first * spitch[p] / 2); i < last * spitch[p] / 2; ++i)
+                    ((uint16_t*)src[p])[i] &= (1 << params.bits) - 1;
+            if (size == 4)
+                for (i = (int)(first * spitch[p] / 4); i < last * spitch[p] / 4; ++i)
+                    ((float*)src[p])[i] = (float)rand() / RAND_MAX;
+
+            memset(dstp[p], 0, dpitch[p] * fcbi_output_height(context, p));
+        }
+
+        if (fcbi_process_frame(fresh, srcp, spitch, refp, dpitch) || fcbi_process_frame(context, srcp, spitch, dstp, dpitch))
+        {
+            ++failures;
+            printf("FAIL fcbi_process_frame: %s\n", fcbi_last_error());
+        }
+
+        for (p = 0; p < params.num_planes; ++p)
+        {
+            for (i = 0; i < fcbi_output_height(context, p); ++i)
+            {
+                if (memcmp(refp[p] + i * dpitch[p], dstp[p] + i * dpitch[p], (size_t)fcbi_output_width(context, p) * out_size))
+                {
+                    ++failures;
+                    printf("FAIL reuse: width=%d height=%d bits=%d factor=%d frame %d plane %d row %d\n", params.width, params.height, params.bits,
+                        params.factor, frame, p, i);
+                    break;
+                }
+            }
+        }
+    }
+
+    for (p = 0; p < params.num_planes; ++p)
+    {
+        free(src[p]);
+        free(dstp[p]);
+        free(refp[p]);
+    }
+
+    fcbi_free(fresh);
+    fcbi_free(context);
+}
+
+/* Upscales a frame with and without stats, the time of the steps of a single thread can not exceed the wall time of the call. */
+static void test_stats(void)
+{
+    fcbi_params params = format(320, 240, 8, 3, 1, 1);
+    const int sizes[3] = { 320 * 240, 160 * 120, 160 * 120 };
+    const ptrdiff_t spitch[3] = { 320, 160, 160 };
+    const ptrdiff_t dpitch[3] = { 640, 320, 320 };
+    const uint8_t* srcp[3];
+    uint8_t* dstp[3];
+    fcbi_context* context;
+    fcbi_stats stats;
+    int run;
+    int i;
+    int p;
+
+    for (p = 0; p < 3; ++p)
+    {
+        uint8_t* src = (uint8_t*)malloc(sizes[p]);
+
+        for (i = 0; i < sizes[p]; ++i)
+            src[i] = (uint8_t)rand();
+
+        srcp[p] = src;
+        dstp[p] = (uint8_t*)malloc(sizes[p] * 4);
+    }
+
+    for (run = 0; run < 2; ++run)
+    {
+        params.stats = run;
+        context = fcbi_create(&params);
+
+        if (!context || fcbi_process_frame(context, srcp, spitch, dstp, dpitch))
+        {
+            ++failures;
+            printf("FAIL stats: %s\n", fcbi_last_error());
+            fcbi_free(context);
+            continue;
+        }
+
+        fcbi_last_stats(&stats);
+
+        if ((run) ? stats.total_us <= 0 || stats.phase1_us < 0 || stats.phase2_us < 0 || stats.phase3_us < 0 || stats.output_us < 0 ||
+            stats.phase1_us + stats.phase2_us + stats.phase3_us + stats.output_us > stats.total_us :
+            stats.total_us || stats.phase1_us || stats.phase2_us || stats.phase3_us || stats.output_us)
+        {
+            ++failures;
+            printf("FAIL stats=%d: phase1 %lld phase2 %lld phase3 %lld output %lld total %lld\n", run, (long long)stats.phase1_us,
+                (long long)stats.phase2_us, (long long)stats.phase3_us, (long long)stats.output_us, (long long)stats.total_us);
+        }
+
+        fcbi_free(context);
+    }
+
+    for (p = 0; p < 3; ++p)
+    {
+        free((void*)srcp[p]);
+        free(dstp[p]);
+    }
+}
+
+/* Converts frames of peak samples (constant, or with one sample below the peak) of bits to 8-bit, upscaled and copied (chroma=2),
+   with rounding and the dither. Every output sample has to be 255. */
+static void test_peak(const int bits)
+{
+    const int sizes[3] = { 64 * 32, 32 * 16, 32 * 16 };
+    const ptrdiff_t spitch[3] = { 128, 64, 64 };
+    const ptrdiff_t dpitch[3] = { 128, 32, 32 };
+    const uint8_t* srcp[3];
+    uint8_t* dstp[3];
+    fcbi_params params = format(64, 32, bits, 3, 1, 1);
+    fcbi_context* context;
+    int run;
+    int i;
+    int p;
+
+    for (p = 0; p < 3; ++p)
+    {
+        uint16_t* src = (uint16_t*)malloc(sizes[p] * 2);
+
+        for (i = 0; i < sizes[p]; ++i)
+            src[i] = (uint16_t)((1 << bits) - 1);
+
+        srcp[p] = (const uint8_t*)src;
+        dstp[p] = (uint8_t*)malloc(sizes[p] * 4);
+    }
+
+    params.output_bits = 8;
+    params.chroma = 2;
+
+    for (run = 0; run < 4; ++run)
+    {
+        params.dither = run & 1;
+        /* A single lower sample keeps the planes from being filled as constant. */
+        ((uint16_t*)srcp[0])[0] = (uint16_t)((run & 2) ? (1 << bits) - 2 : (1 << bits) - 1);
+        context = fcbi_create(&params);
+
+        if (!context || fcbi_process_frame(context, srcp, spitch, dstp, dpitch))
+        {
+            ++failures;
+            printf("FAIL peak: %s\n", fcbi_last_error());
+            fcbi_free(context);
+            continue;
+        }
+
+        for (p = 0; p < 3; ++p)
+        {
+            const int bytes = (p) ? sizes[p] : sizes[p] * 4;
+
+            for (i = 0; i < bytes && dstp[p][i] == 255; ++i)
+                ;
+
+            if (i < bytes)
+            {
+                ++failures;
+                printf("FAIL peak: bits=%d dither=%d constant=%d plane %d sample %d is %d\n", bits, params.dither, !(run & 2), p, i, dstp[p][i]);
+            }
+        }
+
+        fcbi_free(context);
+    }
+
+    for (p = 0; p < 3; ++p)
+    {
+        free((void*)srcp[p]);
+        free(dstp[p]);
+    }
+}
+
+static void test_trace(void)
+{
+    static char set[] = "FCBI_TRACE=fcbi_core_test_trace.json";
+    static char unset[] = "FCBI_TRACE=";
+    static const char* const spans[] = { "\"name\":\"frame\"", "\"name\":\"band\"", "\"name\":\"phase1\"", "\"name\":\"phase2\"",
+        "\"name\":\"phase3\"", "\"plane\":2" };
+    fcbi_params params = format(320, 240, 8, 3, 1, 1);
+    const int sizes[3] = { 320 * 240, 160 * 120, 160 * 120 };
+    const ptrdiff_t spitch[3] = { 320, 160, 160 };
+    const ptrdiff_t dpitch[3] = { 640, 320, 320 };
+    const uint8_t* srcp[3];
+    uint8_t* dstp[3];
+    fcbi_context* context;
+    char* trace;
+    FILE* file;
+    long size;
+    int i;
+    int p;
+
+    for (p = 0; p < 3; ++p)
+    {
+        uint8_t* src = (uint8_t*)malloc(sizes[p]);
+
+        for (i = 0; i < sizes[p]; ++i)
+            src[i] = (uint8_t)rand();
+
+        srcp[p] = src;
+        dstp[p] = (uint8_t*)malloc(sizes[p] * 4);
+    }
+
+    putenv(set);
+    params.threads = 4;
+    context = fcbi_create(&params);
+    putenv(unset);
+
+    if (!context || fcbi_process_frame(context, srcp, spitch, dstp, dpitch) || fcbi_process_frame(context, srcp, spitch, dstp, dpitch))
+    {
+        ++failures;
+        printf("FAIL trace: %s\n", fcbi_last_error());
+    }
+
+    fcbi_free(context);
+
+    for (p = 0; p < 3; ++p)
+    {
+        free((void*)srcp[p]);
+        free(dstp[p]);
+    }
+
+    file = fopen("fcbi_core_test_trace.json", "rb");
+
+    if (!file)
+    {
+        ++failures;
+        printf("FAIL trace was not written\n");
+        return;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    trace = (char*)calloc(size + 1, 1);
+    size = (long)fread(trace, 1, size, file);
+    fclose(file);
+    remove("fcbi_core_test_trace.json");
+
+    if (strncmp(trace, "{\"traceEvents\":[", 16) || !strstr(trace, "]}"))
+    {
+        ++failures;
+        printf("FAIL trace is not a Chrome trace\n");
+    }
+
+    for (i = 0; i < (int)(sizeof(spans) / sizeof(spans[0])); ++i)
+    {
+        if (!strstr(trace, spans[i]))
+        {
+            ++failures;
+            printf("FAIL trace has no %s\n", spans[i]);
+        }
+    }
+
+    free(trace);
+}
+
+int main(void)
+{
+    fcbi_params p;
+
+    srand(1);
+
+    test_params();
+
+    test_frame(format(16, 16, 8, 1, 0, 0));
+    p = format(720, 480, 8, 3, 1, 1); p.edge = 1; test_frame(p);
+    test_frame(format(333, 97, 10, 3, 0, 0));
+    p = format(258, 130, 16, 3, 1, 0); p.edge = 1; test_frame(p);
+    p = format(190, 66, 32, 3, 1, 1); p.edge = 1; test_frame(p);
+    p = format(320, 180, 8, 3, 1, 1); p.edge = 1; p.factor = 4; test_frame(p);
+    p = format(75, 41, 12, 3, 0, 1); p.factor = 8; test_frame(p);
+    p = format(64, 48, 32, 1, 0, 0); p.edge = 1; p.factor = 4; test_frame(p);
+    p = format(192, 108, 8, 3, 1, 1); p.edge = 1; p.target_width = 256; p.target_height = 144; test_frame(p);
+    p = format(128, 72, 16, 3, 0, 0); p.factor = 4; p.target_width = 300; p.target_height = 200; test_frame(p);
+    p = format(100, 60, 32, 3, 1, 0); p.edge = 1; p.target_width = 150; test_frame(p);
+    p = format(96, 54, 8, 3, 1, 1); p.center = 1; test_frame(p);
+    p = format(81, 45, 10, 3, 1, 1); p.edge = 1; p.factor = 4; p.target_width = 180; p.target_height = 90; p.center = 1; test_frame(p);
+    p = format(160, 90, 8, 3, 1, 1); p.output_bits = 16; test_frame(p);
+    p = format(99, 50, 10, 3, 1, 0); p.factor = 4; p.output_bits = 8; p.dither = 1; test_frame(p);
+    p = format(120, 68, 12, 1, 0, 0); p.output_bits = 10; test_frame(p);
+    p = format(140, 80, 8, 3, 1, 1); p.output_bits = 10; p.target_width = 200; p.target_height = 120; test_frame(p);
+    p = format(140, 80, 16, 3, 1, 1); p.output_bits = 8; p.dither = 1; p.center = 1; test_frame(p);
+    p = format(200, 120, 8, 3, 0, 0); p.edge = 1; p.chroma = 1; test_frame(p);
+    p = format(90, 50, 32, 3, 1, 1); p.chroma = 1; p.factor = 4; p.target_width = 200; p.target_height = 100; test_frame(p);
+    p = format(110, 64, 10, 3, 1, 0); p.chroma = 1; p.output_bits = 16; p.center = 1; test_frame(p);
+    p = format(160, 96, 8, 3, 0, 0); p.chroma = 2; test_frame(p);
+    p = format(160, 96, 12, 3, 1, 1); p.chroma = 2; p.factor = 4; p.output_bits = 8; p.dither = 1; p.center = 1; test_frame(p);
+    p = format(64, 40, 8, 3, 0, 0); p.chroma = 2; p.output_bits = 14; test_frame(p);
+    if (fcbi_max_opt() >= 1)
+    {
+        p = format(333, 97, 8, 3, 0, 0); p.edge = 1; p.opt = 1; test_frame(p);
+        p = format(258, 130, 16, 3, 1, 0); p.opt = 1; test_frame(p);
+        p = format(190, 66, 32, 3, 1, 1); p.opt = 1; p.chroma = 1; test_frame(p);
+    }
+    p = format(200, 100, 8, 3, 1, 1); p.edge = 1; p.crop_left = 36; p.crop_top = 18; p.crop_right = 100; p.crop_bottom = 40; test_frame(p);
+    p = format(96, 64, 16, 3, 0, 0); p.factor = 4; p.crop_left = 3; p.crop_top = 1; p.crop_right = 250; p.crop_bottom = 7; test_frame(p);
+
+    p = format(200, 100, 8, 3, 1, 1); p.edge = 1; p.crop_left = 36; p.crop_top = 18; p.crop_right = 100; p.crop_bottom = 40; test_crop(p);
+    p = format(200, 100, 8, 3, 1, 1); p.crop_top = 50; p.crop_bottom = 70; test_crop(p);
+    p = format(96, 64, 16, 3, 0, 0); p.factor = 4; p.crop_left = 3; p.crop_top = 1; p.crop_right = 250; p.crop_bottom = 7; test_crop(p);
+    p = format(96, 64, 10, 3, 1, 0); p.factor = 8; p.crop_left = 300; p.crop_top = 201; p.crop_right = 302; p.crop_bottom = 250; test_crop(p);
+    p = format(120, 80, 32, 1, 0, 0); p.edge = 1; p.crop_left = 1; p.crop_right = 201; test_crop(p);
+    p = format(120, 80, 12, 3, 1, 1); p.output_bits = 8; p.dither = 1; p.crop_left = 50; p.crop_top = 20; p.crop_right = 30; p.crop_bottom = 60;
+    test_crop(p);
+    p = format(120, 80, 8, 3, 1, 1); p.output_bits = 16; p.chroma = 1; p.crop_left = 64; p.crop_top = 8; test_crop(p);
+    p = format(150, 90, 8, 3, 1, 1); p.target_width = 280; p.target_height = 160; p.center = 1; p.crop_left = 100; p.crop_top = 50; p.crop_right = 20;
+    p.crop_bottom = 30; test_crop(p);
+    p = format(80, 60, 8, 3, 0, 0); p.chroma = 2; p.output_bits = 10; p.crop_left = 40; p.crop_top = 10; p.crop_right = 2; p.crop_bottom = 30;
+    test_crop(p);
+
+    p = format(200, 100, 8, 3, 1, 1); p.edge = 1; test_reuse(p);
+    p = format(120, 96, 16, 1, 0, 0); p.factor = 4; test_reuse(p);
+    p = format(96, 64, 32, 3, 0, 0); p.factor = 8; p.chroma = 1; test_reuse(p);
+    p = format(160, 120, 10, 3, 1, 0); p.output_bits = 8; p.dither = 1; test_reuse(p);
+    p = format(160, 120, 8, 3, 1, 1); p.output_bits = 12; p.chroma = 2; test_reuse(p);
+    p = format(150, 90, 8, 3, 1, 1); p.target_width = 280; p.target_height = 160; p.center = 1; test_reuse(p);
+    p = format(120, 80, 12, 3, 1, 1); p.factor = 4; p.target_width = 300; p.target_height = 250; p.output_bits = 8; test_reuse(p);
+    p = format(200, 100, 8, 3, 1, 1); p.crop_left = 36; p.crop_top = 18; p.crop_right = 100; p.crop_bottom = 40; test_reuse(p);
+    p = format(96, 64, 16, 3, 0, 0); p.factor = 4; p.crop_top = 1; p.crop_bottom = 7; test_reuse(p);
+
+    test_peak(10);
+    test_peak(16);
+
+    test_stats();
+    test_trace();
+
+    printf("%d failures\n", failures);
+
+    return (failures) ? 1 : 0;
+}
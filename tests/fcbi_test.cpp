@@ -0,0 +1,681 @@
+// Bit-exactness test of the SIMD kernels against phase1_c/phase2_c/phase3_c and bilinear_c.
+// usage: fcbi_test opt [iterations] [seed]
+// Every iteration picks a random size, bit depth (or float), tm and ed, runs each phase of the opt level and of the C code on the same input
+// and compares the results byte for byte, then runs the threaded strip pipeline against the C phases on the whole plane.
+// Some iterations also compare the 4x/8x cascade against 2x steps run one after another on stored planes,
+// the resize done strip by strip against the resize of the whole upscaled plane, and bit depth conversions of mostly peak samples against
+// a reference computed sample by sample.
+// The tails of the source rows are noise and the rest of the output buffers a fixed pattern, so that kernels using samples past the end of a row
+// or writing outside their rows fail the comparisons. opt 0 also checks the C kernels against hashes of the output of the original release.
+// Returns 77 when the CPU does not support opt.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "fcbi.h"
+#include "fcbi_thread_pool.h"
+#include "VCL2/instrset.h"
+
+using phase1_t = void (*)(const uint8_t* srcp, uint8_t* __restrict dstp, const int width, const int height, const int spitch, const int dpitch, const int top, const int bottom) noexcept;
+using phase2_t = void (*)(uint8_t* __restrict ptr, const int width, const int height, const int pitch, const int tm, const int top, const int bottom) noexcept;
+using phase3_t = void (*)(const uint8_t* srcp, uint8_t* __restrict dstp, const int width, const int height, const int spitch, const int dpitch, const int tm, const int top, const int bottom) noexcept;
+
+struct kernels
+{
+    const char* name;
+    phase1_t phase1;
+    phase2_t phase2;
+    phase3_t phase3;
+    phase1_t bilinear;
+};
+
+template <typename T>
+static std::vector<kernels> opt_kernels(const int opt, const bool ed, const int iset)
+{
+    if (opt == 3)
+        return { { "avx512", phase1_avx512<T>, (ed) ? phase2_avx512<T, true> : phase2_avx512<T, false>, (ed) ? phase3_avx512<T, true> : phase3_avx512<T, false>, bilinear_avx512<T> } };
+    if (opt == 2)
+        return { { "avx2", phase1_avx2<T>, (ed) ? phase2_avx2<T, true> : phase2_avx2<T, false>, (ed) ? phase3_avx2<T, true> : phase3_avx2<T, false>, bilinear_avx2<T> } };
+    if (opt == 1)
+    {
+        std::vector<kernels> k{ { "sse2", phase1_sse2<T>, (ed) ? phase2_sse2<T, true> : phase2_sse2<T, false>, (ed) ? phase3_sse2<T, true> : phase3_sse2<T, false>, bilinear_sse2<T> } };
+
+        if constexpr (std::is_same_v<T, uint16_t>)
+        {
+            if (iset >= 5)
+                k.push_back({ "sse41", phase1_sse2<T>, (ed) ? phase2_sse41<T, true> : phase2_sse41<T, false>, (ed) ? phase3_sse41<T, true> : phase3_sse41<T, false>, bilinear_sse2<T> });
+        }
+
+        return k;
+    }
+
+    return { { "c", phase1_c<T>, (ed) ? phase2_c<T, true> : phase2_c<T, false>, (ed) ? phase3_c<T, true> : phase3_c<T, false>, bilinear_c<T> } };
+}
+
+struct plane_buffer
+{
+    int pitch;
+    std::vector<uint8_t> data;
+
+    // rows plus one spare row above for the left padding; filled with a pattern that no kernel writes.
+    plane_buffer(const int row_size, const int rows)
+        : pitch((row_size + 63) & ~63), data(static_cast<size_t>(pitch) * (rows + 1) + 64, 0xA5)
+    {
+    }
+
+    uint8_t* row(const int y) noexcept
+    {
+        return data.data() + static_cast<size_t>(y + 1) * pitch;
+    }
+
+    // Fills everything but the first row_size bytes of the rows 0..rows - 1 with noise.
+    template <typename Rng>
+    void poison(const int row_size, const int rows, Rng& gen)
+    {
+        for (size_t i{ 0 }; i < data.size(); ++i)
+        {
+            const size_t y{ i / pitch };
+
+            if (y < 1 || y > static_cast<size_t>(rows) || i % pitch >= static_cast<size_t>(row_size))
+                data[i] = static_cast<uint8_t>(gen());
+        }
+    }
+};
+
+static std::mt19937 rng;
+static int failures{ 0 };
+
+// Rows of noise, flat runs, hard edges and values around tm, from a generator of its own so that the planes do not depend on the other tests.
+template <typename T>
+static void golden_source(plane_buffer& src, const int width, const int height, const int bits, const int tm, const unsigned seed)
+{
+    const int peak{ (1 << bits) - 1 };
+    std::mt19937 gen{ seed };
+
+    for (int y{ 0 }; y < height; ++y)
+    {
+        T* row{ reinterpret_cast<T*>(src.row(y)) };
+        const int kind{ static_cast<int>(gen() % 4) };
+
+        for (int x{ 0 }; x < width; ++x)
+            row[x] = static_cast<T>((kind == 0) ? gen() & peak : (kind == 1) ? peak / 2 : (kind == 2) ? ((x / 3) & 1) * peak : (peak / 2 + static_cast<int>(gen() % (4 * tm + 1)) - 2 * tm) & peak);
+    }
+}
+
+// FNV-1a of the 2x upscale of golden_source by the C kernels. Sample 1 of the even rows is left out, the original phase3_c computed it
+// from left padding of the odd rows that phase2_c never wrote.
+template <typename T>
+static uint64_t golden_hash(const int width, const int height, const int bits, const int tm, const bool ed, const unsigned seed)
+{
+    const int dwidth{ 2 * width };
+    const int dheight{ 2 * height };
+    plane_buffer src(width * sizeof(T), height);
+    plane_buffer window((dwidth + 4) * sizeof(T), dheight + 1);
+    plane_buffer dst(dwidth * sizeof(T), dheight);
+
+    golden_source<T>(src, width, height, bits, tm, seed);
+
+    phase1_c<T>(src.row(0), window.row(0), width, height, src.pitch, window.pitch, 0, height);
+    if (ed)
+    {
+        phase2_c<T, true>(window.row(0), dwidth, dheight, window.pitch, tm, 0, dheight);
+        phase3_c<T, true>(window.row(0), dst.row(0), dwidth, dheight, window.pitch, dst.pitch, tm, 0, dheight);
+    }
+    else
+    {
+        phase2_c<T, false>(window.row(0), dwidth, dheight, window.pitch, tm, 0, dheight);
+        phase3_c<T, false>(window.row(0), dst.row(0), dwidth, dheight, window.pitch, dst.pitch, tm, 0, dheight);
+    }
+
+    uint64_t hash{ 14695981039346656037ull };
+
+    for (int y{ 0 }; y < dheight; ++y)
+    {
+        const uint8_t* row{ dst.row(y) };
+
+        for (int i{ 0 }; i < dwidth * static_cast<int>(sizeof(T)); ++i)
+        {
+            if (!(y & 1) && i / static_cast<int>(sizeof(T)) == 1)
+                continue;
+
+            hash = (hash ^ row[i]) * 1099511628211ull;
+        }
+    }
+
+    return hash;
+}
+
+// golden_hash of the original phase1_c/phase2_c/phase3_c, the seed is the index + 1.
+struct golden
+{
+    int width;
+    int height;
+    int bits;
+    int tm;
+    bool ed;
+    uint64_t hash;
+};
+
+static const golden goldens[]
+{
+    { 37, 19, 8, 30, true, 0x4a2a59836637aedcull },
+    { 37, 19, 8, 30, false, 0x598967f140726f8dull },
+    { 64, 33, 8, 0, true, 0x69c5b6d7cbf6dc60ull },
+    { 16, 16, 8, 255, true, 0x0990a31e99eac35eull },
+    { 130, 41, 8, 12, true, 0x8be9f8c2738edcc2ull },
+    { 101, 47, 10, 120, true, 0xa41f74523b54e334ull },
+    { 101, 47, 10, 120, false, 0x931d32ee4bd92ffcull },
+    { 53, 28, 16, 7710, true, 0x9e70411121aa1460ull },
+    { 53, 28, 16, 65535, false, 0xf89a63c7bccaf1c0ull },
+    { 200, 24, 12, 481, true, 0xb7ef2e322bdfc449ull },
+};
+
+// Shrinks the strips and chunks of layout to random even heights, so that planes are split at many rows.
+// taps are the vertical taps of the resize, if the layout has one.
+static fcbi_layout random_layout(fcbi_layout layout, const int taps = 0)
+{
+    size_t size{ 0 };
+
+    for (int k{ 0 }; k < layout.stages; ++k)
+    {
+        layout.strip[k] = std::min(layout.strip[k], 2 * (1 + static_cast<int>(rng() % 24)));
+        layout.window[k] = size;
+        size += static_cast<size_t>(layout.strip[k] + strip_halo) * layout.wpitch[k];
+
+        if (layout.chunk[k])
+        {
+            layout.chunk[k] = std::min(layout.chunk[k], 2 * (1 + static_cast<int>(rng() % 32)));
+            layout.buffer[k] = size;
+            size += static_cast<size_t>(layout.chunk[k] / 2 + 8) * layout.ipitch[k];
+        }
+    }
+
+    // The output buffer of the conversion or crop.
+    if (layout.chunk[layout.stages])
+    {
+        const int k{ layout.stages };
+
+        layout.chunk[k] = std::min(layout.chunk[k], 2 * (1 + static_cast<int>(rng() % 32)));
+        layout.buffer[k] = size;
+        size += static_cast<size_t>(layout.chunk[k] + 2) * layout.ipitch[k];
+    }
+
+    if (layout.rrows)
+    {
+        layout.rrows = std::min(layout.rrows, ((taps + 3) & ~1) + 2 * static_cast<int>(rng() % 16));
+        layout.rbuffer = size;
+        size += static_cast<size_t>(layout.rrows) * layout.rpitch;
+        layout.hbuffer = size;
+        size += static_cast<size_t>(layout.rrows) * layout.hpitch;
+    }
+
+    layout.size = size;
+
+    return layout;
+}
+
+// Runs process_frame on the plane of args with 1..4 threads.
+static void run_frame(const fcbi_plane& args, const fcbi_layout& layout, const int tm, const fcbi_kernels& k)
+{
+    const int threads{ 1 + static_cast<int>(rng() % 4) };
+    thread_pool pool{ threads };
+    scratch_pool scratch{ layout.size * threads };
+
+    process_frame(&args, 1, scratch, layout, tm, threads, pool, k);
+}
+
+// Upscales src (width x height) by factor through stored 2x planes and by the cascade, and compares the results.
+template <typename T>
+static bool cascade_equal(const fcbi_kernels& k, const uint8_t* srcp, const int spitch, const int width, const int height, const int tm, const int factor,
+    const plane_mode mode)
+{
+    std::vector<uint8_t> ref;
+    int ref_pitch{ spitch };
+    const uint8_t* refp{ srcp };
+    std::vector<uint8_t> step;
+
+    for (int f{ 1 }; f < factor; f *= 2)
+    {
+        const int w{ width * f };
+        const int h{ height * f };
+        const fcbi_layout layout{ plan_layout(w, h, sizeof(T), 2) };
+        const int pitch{ static_cast<int>((2 * w * sizeof(T) + 63) & ~63) };
+
+        step.assign(static_cast<size_t>(pitch) * 2 * h, 0);
+        run_frame({ refp, ref_pitch, w, h, step.data(), pitch, nullptr, nullptr, mode }, layout, tm, k);
+
+        ref.swap(step);
+        refp = ref.data();
+        ref_pitch = pitch;
+    }
+
+    const fcbi_layout layout{ (rng() & 1) ? plan_layout(width, height, sizeof(T), factor) : random_layout(plan_layout(width, height, sizeof(T), factor)) };
+    std::vector<uint8_t> dst(ref.size(), 0);
+
+    run_frame({ srcp, spitch, width, height, dst.data(), ref_pitch, nullptr, nullptr, mode }, layout, tm, k);
+
+    return dst == ref;
+}
+
+template <typename T>
+static bool rows_equal(plane_buffer& a, plane_buffer& b, const int y, const int first, const int last)
+{
+    const T* ra{ reinterpret_cast<const T*>(a.row(y)) };
+    const T* rb{ reinterpret_cast<const T*>(b.row(y)) };
+
+    return !memcmp(ra + first, rb + first, (last - first) * sizeof(T));
+}
+
+// Upscales src (width x height) by factor and resizes it to target_width x target_height strip by strip,
+// and compares the result with the resize of the whole upscaled plane.
+template <typename T>
+static bool resize_equal(const fcbi_kernels& k, const uint8_t* srcp, const int spitch, const int width, const int height, const int bits, const int tm,
+    const int factor, const int target_width, const int target_height)
+{
+    const int uwidth{ factor * width };
+    const int uheight{ factor * height };
+    const fcbi_layout up_layout{ plan_layout(width, height, sizeof(T), factor) };
+    const int upitch{ static_cast<int>((uwidth * sizeof(T) + 63) & ~63) };
+    std::vector<uint8_t> up(static_cast<size_t>(upitch) * uheight);
+
+    run_frame({ srcp, spitch, width, height, up.data(), upitch }, up_layout, tm, k);
+
+    // A center shift half of the time.
+    const bool center{ !!(rng() & 1) };
+    const double shift_x{ (center) ? center_shift(uwidth, target_width, factor, 0, 0.0) : 0.0 };
+    const double shift_y{ (center) ? center_shift(uheight, target_height, factor, 1, 1.0) : 0.0 };
+    const fcbi_resize resize{ make_resize(uwidth, uheight, target_width, target_height, shift_x, shift_y, bits, bits, false) };
+    const int hpitch{ (target_width + 15) & ~15 };
+    const int dpitch{ static_cast<int>((target_width * sizeof(T) + 63) & ~63) };
+    std::vector<float> h(static_cast<size_t>(hpitch) * uheight);
+    std::vector<uint8_t> ref(static_cast<size_t>(dpitch) * target_height, 0);
+
+    resize.horizontal(up.data(), upitch, h.data(), hpitch, uheight, resize.x);
+    for (int y{ 0 }; y < target_height; ++y)
+        resize.vertical(h.data() + static_cast<size_t>(resize.y.first[y]) * hpitch, hpitch, ref.data() + static_cast<size_t>(y) * dpitch, y, resize);
+
+    const fcbi_layout planned{ plan_layout(width, height, sizeof(T), factor, target_width, target_height) };
+    const fcbi_layout layout{ (rng() & 1) ? planned : random_layout(planned, resize.y.taps) };
+    std::vector<uint8_t> dst(ref.size(), 0);
+
+    run_frame({ srcp, spitch, width, height, dst.data(), dpitch, &resize }, layout, tm, k);
+
+    return dst == ref;
+}
+
+// Sample v of output row y and column x converted down by shift: rounded, or with the ordered dither, and clamped to the output peak.
+// Computed in double precision, independently of the integer biases of convert.output.
+static int reference_output(const int v, const int x, const int y, const int output_bits, const int shift, const bool dither)
+{
+    const double offset{ (dither) ? (2 * dither_matrix[y & 7][x & 7] + 1) / 128.0 : 0.5 };
+
+    return std::min(static_cast<int>(std::floor(v / static_cast<double>(1 << shift) + offset)), (1 << output_bits) - 1);
+}
+
+// Checks convert.output on every 10..16-bit sample value and at every dither phase, then upscales a source (width x height) of
+// mostly peak and near-peak samples, sometimes constant, converted to output_bits strip by strip. The result is compared with the
+// upscale of the source shifted up by the test, or with the upscale at bits converted sample by sample by reference_output.
+static bool convert_equal(const fcbi_kernels& k, const int width, const int height, const int bits, const int tm, const int output_bits,
+    const bool dither)
+{
+    const fcbi_convert convert{ make_convert(bits, output_bits, dither) };
+    const int peak{ (1 << bits) - 1 };
+    const int out_size{ (output_bits == 8) ? 1 : 2 };
+    const auto sample = [&](const std::vector<uint8_t>& plane, const size_t i) -> int
+    {
+        return (out_size == 1) ? plane[i] : reinterpret_cast<const uint16_t*>(plane.data())[i];
+    };
+
+    if (convert.output)
+    {
+        // 8 rows of all sample values, each row at another dither phase.
+        const int count{ peak + 1 };
+        std::vector<uint16_t> values(static_cast<size_t>(count) * 8);
+        std::vector<uint8_t> converted(values.size() * out_size);
+
+        for (size_t i{ 0 }; i < values.size(); ++i)
+            values[i] = static_cast<uint16_t>(i % count);
+
+        convert.output(reinterpret_cast<const uint8_t*>(values.data()), count * 2, converted.data(), count * out_size, count, 3, 5, 8, convert);
+
+        for (int y{ 0 }; y < 8; ++y)
+        {
+            for (int x{ 0 }; x < count; ++x)
+            {
+                if (sample(converted, static_cast<size_t>(y) * count + x) != reference_output(x, 3 + x, 5 + y, output_bits, convert.shift, dither))
+                    return false;
+            }
+        }
+    }
+
+    const bool constant{ rng() % 4 == 0 };
+    const int spitch{ width * 2 };
+    std::vector<uint16_t> src(static_cast<size_t>(width) * height, static_cast<uint16_t>(peak));
+
+    if (!constant)
+    {
+        for (uint16_t& v : src)
+            v = static_cast<uint16_t>((rng() & 1) ? peak - static_cast<int>(rng() % 4) : rng() % (peak + 1));
+    }
+
+    const int dwidth{ 2 * width };
+    const int dheight{ 2 * height };
+    std::vector<uint8_t> ref(static_cast<size_t>(dwidth) * dheight * out_size);
+    // Upscaled at the higher of the two depths.
+    std::vector<uint16_t> up(static_cast<size_t>(dwidth) * dheight);
+    std::vector<uint16_t> shifted(src);
+
+    if (convert.source)
+    {
+        for (uint16_t& v : shifted)
+            v = static_cast<uint16_t>(v << convert.shift);
+    }
+
+    run_frame({ reinterpret_cast<const uint8_t*>(shifted.data()), spitch, width, height, reinterpret_cast<uint8_t*>(up.data()), dwidth * 2 },
+        plan_layout(width, height, 2, 2), (convert.source) ? tm << convert.shift : tm, k);
+
+    for (int y{ 0 }; y < dheight; ++y)
+    {
+        for (int x{ 0 }; x < dwidth; ++x)
+        {
+            const size_t i{ static_cast<size_t>(y) * dwidth + x };
+            const int v{ (convert.output) ? reference_output(up[i], x, y, output_bits, convert.shift, dither) : up[i] };
+
+            if (out_size == 1)
+                ref[i] = static_cast<uint8_t>(v);
+            else
+                reinterpret_cast<uint16_t*>(ref.data())[i] = static_cast<uint16_t>(v);
+        }
+    }
+
+    const fcbi_layout planned{ plan_layout(width, height, 2, 2, 0, 0, !!convert.source, !!convert.output) };
+    const fcbi_layout layout{ (rng() & 1) ? planned : random_layout(planned) };
+    std::vector<uint8_t> dst(ref.size(), 0);
+
+    run_frame({ reinterpret_cast<const uint8_t*>(src.data()), spitch, width, height, dst.data(), dwidth * out_size, nullptr, &convert }, layout,
+        (convert.source) ? tm << convert.shift : tm, k);
+
+    return dst == ref;
+}
+
+// Upscales src (width x height) by factor with a crop to the rectangle at x, y of crop_width x crop_height,
+// and compares the result with that rectangle of the whole upscaled plane.
+template <typename T>
+static bool crop_equal(const fcbi_kernels& k, const uint8_t* srcp, const int spitch, const int width, const int height, const int tm, const int factor,
+    const int x, const int y, const int crop_width, const int crop_height)
+{
+    const int pitch{ static_cast<int>((factor * width * sizeof(T) + 63) & ~63) };
+    std::vector<uint8_t> full(static_cast<size_t>(pitch) * factor * height, 0);
+
+    run_frame({ srcp, spitch, width, height, full.data(), pitch }, plan_layout(width, height, sizeof(T), factor), tm, k);
+
+    const int dpitch{ static_cast<int>((crop_width * sizeof(T) + 63) & ~63) };
+    std::vector<uint8_t> dst(static_cast<size_t>(dpitch) * crop_height, 0);
+    const fcbi_layout planned{ plan_layout(width, height, sizeof(T), factor, 0, 0, false, true) };
+    const fcbi_layout layout{ (rng() & 1) ? planned : random_layout(planned) };
+
+    run_frame({ srcp, spitch, width, height, dst.data(), dpitch, nullptr, nullptr, plane_mode::fcbi, x, y, crop_width, crop_height }, layout, tm, k);
+
+    for (int i{ 0 }; i < crop_height; ++i)
+        if (memcmp(dst.data() + static_cast<size_t>(i) * dpitch, full.data() + static_cast<size_t>(y + i) * pitch + x * sizeof(T), crop_width * sizeof(T)))
+            return false;
+
+    return true;
+}
+
+template <typename T>
+static void test(const kernels& c, const kernels& k, const int width, const int height, const int bits, const int tm, const bool ed)
+{
+    const int peak{ (bits == 32) ? 255 : (1 << bits) - 1 };
+    const int dwidth{ 2 * width };
+    const int dheight{ 2 * height };
+
+    // Some planes are constant, which process_frame fills without the kernels.
+    const bool constant{ rng() % 8 == 0 };
+
+    plane_buffer src(width * sizeof(T), height);
+    for (int y{ 0 }; y < height; ++y)
+    {
+        T* row{ reinterpret_cast<T*>(src.row(y)) };
+        const int kind{ (constant) ? 1 : static_cast<int>(rng() % 4) };
+
+        // Noise, flat runs, hard edges and values around the thresholds.
+        for (int x{ 0 }; x < width; ++x)
+        {
+            if constexpr (std::is_floating_point_v<T>)
+                row[x] = (kind == 0) ? static_cast<float>(rng()) / 4294967296.0f : (kind == 1) ? 0.5f : (kind == 2) ? static_cast<float>((x / 3) & 1) :
+                    0.5f + (static_cast<int>(rng() % (4 * tm + 1)) - 2 * tm) / 255.0f;
+            else
+                row[x] = static_cast<T>((kind == 0) ? rng() & peak : (kind == 1) ? peak / 2 : (kind == 2) ? ((x / 3) & 1) * peak : (peak / 2 + static_cast<int>(rng() % (4 * tm + 1)) - 2 * tm) & peak);
+        }
+    }
+
+    src.poison(width * sizeof(T), height, rng);
+
+    // Window of the whole plane: output rows 0..dheight, two samples of left padding and up to four on the right.
+    const int row_size{ (dwidth + 4) * static_cast<int>(sizeof(T)) };
+    plane_buffer wc(row_size, dheight + 1);
+    plane_buffer wk(row_size, dheight + 1);
+
+    const auto fail{ [&](const char* phase, const int y)
+    {
+        ++failures;
+        printf("FAIL %s %s: width=%d height=%d bits=%d tm=%d ed=%d row %d\n", k.name, phase, width, height, bits, tm, ed, y);
+    } };
+
+    // phase1 defines the even rows, the two rows below the plane and the left/right padding.
+    c.phase1(src.row(0), wc.row(0), width, height, src.pitch, wc.pitch, 0, height);
+    k.phase1(src.row(0), wk.row(0), width, height, src.pitch, wk.pitch, 0, height);
+
+    for (int y{ 0 }; y <= dheight; ++y)
+    {
+        if ((y & 1) && y < dheight - 1)
+            continue;
+        if (!rows_equal<T>(wc, wk, y, -2, dwidth + 1))
+            return fail("phase1", y);
+    }
+
+    // The rest of the buffers still holds the pattern they were filled with, unless one of the kernels wrote outside its samples.
+    if (wc.data != wk.data)
+        return fail("phase1 outside the rows", -1);
+
+    // phase2 and phase3 start from the same input.
+    wk.data = wc.data;
+
+    c.phase2(wc.row(0), dwidth, dheight, wc.pitch, tm, 0, dheight);
+    k.phase2(wk.row(0), dwidth, dheight, wk.pitch, tm, 0, dheight);
+
+    for (int y{ 1 }; y < dheight - 1; y += 2)
+        if (!rows_equal<T>(wc, wk, y, -2, dwidth))
+            return fail("phase2", y);
+    if (wc.data != wk.data)
+        return fail("phase2 outside the rows", -1);
+
+    wk.data = wc.data;
+
+    plane_buffer dc(dwidth * sizeof(T), dheight);
+    plane_buffer dk(dwidth * sizeof(T), dheight);
+
+    c.phase3(wc.row(0), dc.row(0), dwidth, dheight, wc.pitch, dc.pitch, tm, 0, dheight);
+    k.phase3(wk.row(0), dk.row(0), dwidth, dheight, wk.pitch, dk.pitch, tm, 0, dheight);
+
+    // The whole pitch is compared, so that writes past the end of a row are caught as well.
+    for (int y{ 0 }; y < dheight; ++y)
+        if (!rows_equal<T>(dc, dk, y, 0, dk.pitch / sizeof(T)))
+            return fail("phase3", y);
+    if (dc.data != dk.data)
+        return fail("phase3 outside the rows", -1);
+
+    // The strip pipeline with random strips and threads has to give the same plane.
+    const fcbi_layout layout{ (rng() & 1) ? plan_layout(width, height, sizeof(T), 2) : random_layout(plan_layout(width, height, sizeof(T), 2)) };
+    plane_buffer dp(dwidth * sizeof(T), dheight);
+
+    run_frame({ src.row(0), src.pitch, width, height, dp.row(0), dp.pitch }, layout, tm, { k.phase1, k.phase2, k.phase3, k.bilinear });
+
+    for (int y{ 0 }; y < dheight; ++y)
+        if (!rows_equal<T>(dc, dp, y, 0, dp.pitch / sizeof(T)))
+            return fail("process_frame", y);
+    if (dc.data != dp.data)
+        return fail("process_frame outside the rows", -1);
+
+    // The bilinear kernel on the whole plane and through the strip pipeline.
+    plane_buffer bc(dwidth * sizeof(T), dheight);
+    plane_buffer bk(dwidth * sizeof(T), dheight);
+
+    c.bilinear(src.row(0), bc.row(0), width, height, src.pitch, bc.pitch, 0, dheight);
+    k.bilinear(src.row(0), bk.row(0), width, height, src.pitch, bk.pitch, 0, dheight);
+
+    for (int y{ 0 }; y < dheight; ++y)
+        if (!rows_equal<T>(bc, bk, y, 0, bk.pitch / sizeof(T)))
+            return fail("bilinear", y);
+    if (bc.data != bk.data)
+        return fail("bilinear outside the rows", -1);
+
+    run_frame({ src.row(0), src.pitch, width, height, dp.row(0), dp.pitch, nullptr, nullptr, plane_mode::bilinear }, layout, tm,
+        { k.phase1, k.phase2, k.phase3, k.bilinear });
+
+    for (int y{ 0 }; y < dheight; ++y)
+        if (!rows_equal<T>(bc, dp, y, 0, dp.pitch / sizeof(T)))
+            return fail("process_frame bilinear", y);
+    if (bc.data != dp.data)
+        return fail("process_frame bilinear outside the rows", -1);
+
+    // 8x only on small planes, the output is 64 times the source.
+    const int factor{ (rng() % 4) ? 0 : (width * height <= 4096) ? 8 : (width * height <= 32768) ? 4 : 0 };
+    const plane_mode mode{ (rng() & 1) ? plane_mode::bilinear : plane_mode::fcbi };
+
+    if (factor && !cascade_equal<T>({ k.phase1, k.phase2, k.phase3, k.bilinear }, src.row(0), src.pitch, width, height, tm, factor, mode))
+        fail((factor == 4) ? ((mode == plane_mode::fcbi) ? "cascade x4" : "bilinear cascade x4") : ((mode == plane_mode::fcbi) ? "cascade x8" : "bilinear cascade x8"), 0);
+
+    // Conversions of 10..16-bit clips to a random depth, 8-bit clips are upscaled with the 16-bit kernels when converted.
+    if constexpr (std::is_same_v<T, uint16_t>)
+    {
+        const int output_bits{ 8 + static_cast<int>(rng() % 9) };
+
+        if (rng() % 4 == 0 && output_bits != bits &&
+            !convert_equal({ k.phase1, k.phase2, k.phase3, k.bilinear }, width, height, bits, tm, output_bits, !!(rng() & 1)))
+        {
+            ++failures;
+            printf("FAIL %s convert: width=%d height=%d bits=%d tm=%d ed=%d output_bits=%d\n", k.name, width, height, bits, tm, ed, output_bits);
+        }
+    }
+
+    // Mostly downscales of the upscaled plane, sometimes to a few samples or a shift only.
+    if (rng() % 4 == 0)
+    {
+        const int f{ (width * height <= 16384 && (rng() & 1)) ? 4 : 2 };
+        const int kind{ static_cast<int>(rng() % 8) };
+        const int target_width{ (kind > 1) ? f * width / 3 + static_cast<int>(rng() % (f * width - f * width / 3 + 1)) : (kind) ? f * width : 1 + static_cast<int>(rng() % 8) };
+        const int target_height{ (kind > 1) ? f * height / 3 + static_cast<int>(rng() % (f * height - f * height / 3 + 1)) : (kind) ? f * height : 1 + static_cast<int>(rng() % 8) };
+
+        if (!resize_equal<T>({ k.phase1, k.phase2, k.phase3, k.bilinear }, src.row(0), src.pitch, width, height, bits, tm, f, target_width, target_height))
+        {
+            ++failures;
+            printf("FAIL %s resize: width=%d height=%d bits=%d tm=%d ed=%d factor=%d target %dx%d\n", k.name, width, height, bits, tm, ed, f, target_width,
+                target_height);
+        }
+    }
+
+    // Crops of any position and size, down to a single sample.
+    if (rng() % 4 == 0)
+    {
+        const int f{ (width * height <= 16384 && (rng() & 1)) ? 4 : 2 };
+        const int crop_width{ 1 + static_cast<int>(rng() % (f * width)) };
+        const int crop_height{ 1 + static_cast<int>(rng() % (f * height)) };
+        const int x{ static_cast<int>(rng() % (f * width - crop_width + 1)) };
+        const int y{ static_cast<int>(rng() % (f * height - crop_height + 1)) };
+
+        if (!crop_equal<T>({ k.phase1, k.phase2, k.phase3, k.bilinear }, src.row(0), src.pitch, width, height, tm, f, x, y, crop_width, crop_height))
+        {
+            ++failures;
+            printf("FAIL %s crop: width=%d height=%d bits=%d tm=%d ed=%d factor=%d crop %dx%d at %d,%d\n", k.name, width, height, bits, tm, ed, f, crop_width,
+                crop_height, x, y);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: fcbi_test opt [iterations] [seed]\n");
+        return 1;
+    }
+
+    const int opt{ atoi(argv[1]) };
+    const int iterations{ (argc > 2) ? atoi(argv[2]) : 2000 };
+    rng.seed((argc > 3) ? static_cast<unsigned>(atoi(argv[3])) : 1u);
+
+    const int iset{ instrset_detect() };
+
+    if (opt < 0 || opt > 3)
+    {
+        printf("opt must be between 0..3.\n");
+        return 1;
+    }
+    if (opt > max_opt())
+    {
+        printf("opt=%d is not supported by this CPU, skipped.\n", opt);
+        return 77;
+    }
+
+    if (opt == 0)
+    {
+        for (size_t i{ 0 }; i < std::size(goldens); ++i)
+        {
+            const golden& g{ goldens[i] };
+            const unsigned seed{ static_cast<unsigned>(i + 1) };
+            const uint64_t hash{ (g.bits == 8) ? golden_hash<uint8_t>(g.width, g.height, g.bits, g.tm, g.ed, seed) :
+                golden_hash<uint16_t>(g.width, g.height, g.bits, g.tm, g.ed, seed) };
+
+            if (hash != g.hash)
+            {
+                ++failures;
+                printf("FAIL c golden: width=%d height=%d bits=%d tm=%d ed=%d\n", g.width, g.height, g.bits, g.tm, g.ed);
+            }
+        }
+    }
+
+    // 32 stands for float samples, whose tm is on the 8-bit scale.
+    static const int depths[]{ 8, 10, 12, 14, 16, 32 };
+
+    for (int i{ 0 }; i < iterations; ++i)
+    {
+        // Mostly small planes, so that the tails and borders are a large part of the work, with odd widths and widths not divisible by the vector size.
+        const int width{ 16 + static_cast<int>(rng() % ((i % 5 == 0) ? 700 : 120)) };
+        const int height{ 16 + static_cast<int>(rng() % ((i % 5 == 0) ? 200 : 40)) };
+        const int bits{ depths[rng() % 6] };
+        const int peak{ (bits == 32) ? 255 : (1 << bits) - 1 };
+        const int tm{ (i % 7 == 0) ? 0 : (i % 11 == 0) ? peak : (i % 3 == 0) ? static_cast<int>(rng() % (peak + 1)) : 30 * peak / 255 };
+        const bool ed{ !!(i & 1) };
+
+        if (bits == 8)
+        {
+            const kernels c{ opt_kernels<uint8_t>(0, ed, iset)[0] };
+            for (const auto& k : opt_kernels<uint8_t>(opt, ed, iset))
+                test<uint8_t>(c, k, width, height, bits, tm, ed);
+        }
+        else if (bits == 32)
+        {
+            const kernels c{ opt_kernels<float>(0, ed, iset)[0] };
+            for (const auto& k : opt_kernels<float>(opt, ed, iset))
+                test<float>(c, k, width, height, bits, tm, ed);
+        }
+        else
+        {
+            const kernels c{ opt_kernels<uint16_t>(0, ed, iset)[0] };
+            for (const auto& k : opt_kernels<uint16_t>(opt, ed, iset))
+                test<uint16_t>(c, k, width, height, bits, tm, ed);
+        }
+    }
+
+    printf("opt=%d: %d iterations, %d failures\n", opt, iterations, failures);
+
+    return (failures) ? 1 : 0;
+}